@@ -0,0 +1,97 @@
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include <ros/ros.h>
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+/**
+ * @brief The ConfigCache class Host side copy of the configuration
+ * acknowledged from the board. For each configuration frame is stored
+ * only the hash of the content, in a compact binary file.
+ * A frame with the same hash of the last acknowledged is not sent again.
+ * The cache is associated to the identity of the board: type, name,
+ * version and build of the firmware and an optional identifier of the unit.
+ */
+class ConfigCache
+{
+public:
+    /**
+     * @brief ConfigCache Initialize the cache
+     * @param path file where the cache is stored
+     * @param board identity of the board associated
+     */
+    ConfigCache(string path, string board);
+    /**
+     * @brief load Read the cache from file
+     * @return true if the file is available and is for this board
+     */
+    bool load();
+    /**
+     * @brief save Write the cache on file
+     * @return true if well written
+     */
+    bool save();
+    /**
+     * @brief isSynced Check if the configuration is already on the board.
+     * The hash is stored and become acknowledged with commit()
+     * @param key the command message of the configuration frame
+     * @param data the configuration
+     * @param size size of the configuration
+     * @return true if the board has the same configuration
+     */
+    bool isSynced(unsigned int key, const void *data, size_t size);
+    /**
+     * @brief commit All pending configurations are acknowledged from the board
+     */
+    void commit();
+    /**
+     * @brief discard The pending configurations are not on the board
+     */
+    void discard();
+    /**
+     * @brief invalidate The configuration is changed outside the sync,
+     * it is sent again on the next sync
+     * @param key the command message of the configuration frame
+     */
+    void invalidate(unsigned int key);
+    /**
+     * @brief clear The board state is not known, all configurations are
+     * sent again on the next sync
+     */
+    void clear();
+    /**
+     * @brief update The configuration is acknowledged outside the sync.
+     * Only the copy in memory is updated, the file is written with flush()
+     * @param key the command message of the configuration frame
+     * @param data the configuration
+     * @param size size of the configuration
+     */
+    void update(unsigned int key, const void *data, size_t size);
+    /**
+     * @brief flush Write the cache on file if updated after the last save
+     * @return true if the file is up to date
+     */
+    bool flush();
+
+private:
+    bool saveLocked();
+    static uint64_t hash(const void *data, size_t size);
+
+    // File of the cache
+    string mPath;
+    // Identity of the board
+    string mBoard;
+    // Commit from the initialization and invalidate from the reconfigure
+    mutex mMutex;
+    // Acknowledged and pending configuration
+    map<unsigned int, uint64_t> mAck, mPending;
+    // Updated after the last save
+    bool mDirty;
+};
+
+#endif // CONFIGCACHE_H
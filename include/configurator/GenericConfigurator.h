@@ -6,20 +6,151 @@
 #include <hardware/serial_controller.h>
 #include <dynamic_reconfigure/server.h>
 
+#include <mutex>
+
+#include "configurator/ConfigCache.h"
+#include "configurator/ParamSnapshot.h"
+#include "configurator/ParamWriter.h"
+
 using namespace std;
 
-//template <typename T>
 class GenericConfigurator
 {
+    friend class ParamWriter;
 public:
     GenericConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, unsigned int number);
 
+    virtual ~GenericConfigurator() { }
+
     virtual void initConfigurator() { }
+    /**
+     * @brief initReconfigure Start all dynamic reconfigure servers,
+     * if they are not already running
+     */
+    virtual void initReconfigure() { }
 
-    //virtual void setParam(T) { }
+    /**
+     * @brief setCache Set the configuration cache shared with all configurators
+     * @param cache the cache, NULL to disable
+     */
+    static void setCache(ConfigCache *cache);
+    /**
+     * @brief setSnapshot Set the snapshot of the parameter server shared with all configurators
+     * @param snapshot the snapshot, NULL to read one parameter at time
+     */
+    static void setSnapshot(ParamSnapshot *snapshot);
+    /**
+     * @brief setWriter Set the worker shared with all configurators, the owner
+     * stops it before the configurators are destroyed
+     * @param writer the worker, NULL to drop the updates
+     */
+    static void setWriter(ParamWriter *writer);
+    /**
+     * @brief answer Answer of the board to a configuration frame, called from
+     * the dispatch path. A debounced configuration acknowledged becomes the last sent
+     * @param option PACKET_ACK or PACKET_NACK
+     */
+    void answer(unsigned char option);
 protected:
 
-    void SendParameterToBoard(message_abstract_u message);
+    /**
+     * @brief paramKey Build the key of a parameter of this configurator
+     * @param name name of the parameter, with the leading slash
+     * @return the key
+     */
+    ParamSnapshot::Key paramKey(const string &name) const;
+    /**
+     * @brief readParam Read a parameter from the snapshot if loaded,
+     * otherwise from the parameter server
+     * @param key the key of the parameter
+     * @param value the value, unchanged if not available
+     * @return true if the parameter is available
+     */
+    template <typename T>
+    bool readParam(const ParamSnapshot::Key &key, T &value)
+    {
+        if(mSnapshot != NULL)
+        {
+            return mSnapshot->get(key, value);
+        }
+        return nh_.getParam(key.name, value);
+    }
+
+    /**
+     * @brief isSynced Check on the configuration cache if the board
+     * has already this configuration
+     * @param data the configuration
+     * @param size size of the configuration
+     * @return true if is not required to send the configuration
+     */
+    bool isSynced(const void *data, size_t size);
+    /**
+     * @brief postParam Update the parameter server with the configuration
+     * received from the board. The update is done from a background worker,
+     * this function never blocks and can be called from the dispatch path.
+     * @param message the configuration received
+     */
+    void postParam(const message_abstract_u &message);
+    /**
+     * @brief writeParam Write on the parameter server the configuration.
+     * Called only from the worker thread
+     * @param message the configuration
+     */
+    virtual void writeParam(const message_abstract_u &message) { }
+
+    /**
+     * @brief SendParameterToBoard Build the frame with the configuration
+     * @param message the configuration
+     * @param send if true send immediately the list, otherwise the frame
+     * is queued and sent with the next transaction
+     */
+    void SendParameterToBoard(message_abstract_u message, bool send = true);
+    /**
+     * @brief UpdateParameterToBoard Schedule a new configuration from the
+     * dynamic reconfigure. All changes in the debounce window are merged and
+     * only the last one is queued with the next transaction, if different
+     * from the last configuration acknowledged from the board.
+     * @param message the configuration
+     * @param size size of the configuration in the message
+     */
+    void UpdateParameterToBoard(message_abstract_u message, size_t size);
+
+    /**
+     * @brief loadServer Load a dynamic reconfigure server. If the server is not
+     * created, the configuration is initialized as the server does, without
+     * advertise topics and services
+     * @param server the server, unchanged if already available
+     * @param name namespace of the server
+     * @param callback reconfigure callback
+     * @param obj object of the callback
+     * @param create if true create the server
+     */
+    template <class ConfigType, class T>
+    void loadServer(dynamic_reconfigure::Server<ConfigType>* &server, const string &name,
+                    void (T::*callback)(ConfigType&, uint32_t), T* obj, bool create)
+    {
+        if(server != NULL)
+        {
+            return;
+        }
+        if(create)
+        {
+            server = new dynamic_reconfigure::Server<ConfigType>(ros::NodeHandle(name));
+            typename dynamic_reconfigure::Server<ConfigType>::CallbackType cb = boost::bind(callback, obj, _1, _2);
+            server->setCallback(cb);
+            return;
+        }
+        ros::NodeHandle nh(name);
+        ConfigType config = ConfigType::__getDefault__();
+        config.__fromServer__(nh);
+        config.__clamp__();
+        config.__toServer__(nh);
+        // First call, store the original configuration
+        (obj->*callback)(config, ~0);
+    }
+
+private:
+    void debounceCB(const ros::TimerEvent& event);
 
 protected:
     /// Associate name space
@@ -32,6 +163,24 @@ protected:
     motor_command_map_t mCommand;
     /// Setup variable
     bool setup_;
+    /// Start the dynamic reconfigure servers only on request
+    bool lazy_;
+    /// Debounce of the dynamic reconfigure
+    ros::Timer debounce_timer_;
+    double debounce_;
+    /// Pending, queued and last configuration acknowledged, from reconfigure, timer and dispatch
+    std::mutex param_mutex_;
+    message_abstract_u pending_, queued_, last_sent_;
+    size_t pending_size_, queued_size_;
+    bool sent_;
+    /// A queued configuration waits the answer of the board
+    bool waiting_;
+    /// Cache of the configuration on the board
+    static ConfigCache *mCache;
+    /// Snapshot of the parameter server
+    static ParamSnapshot *mSnapshot;
+    /// Worker of the updates of the parameter server
+    static ParamWriter *mWriter;
 };
 
 #endif // GENERICCONFIGURATOR_H
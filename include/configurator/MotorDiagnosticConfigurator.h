@@ -1,7 +1,7 @@
 #ifndef MOTORDIAGNOSTICCONFIGURATOR_H
 #define MOTORDIAGNOSTICCONFIGURATOR_H
 
-#include "configurator/GenericConfigurator.h"
+#include "configurator/TypedConfigurator.h"
 
 #include <orbus_interface/UnavDiagnosticConfig.h>
 
@@ -13,19 +13,23 @@ typedef struct _MotorLevels
     double warning;  //!< Warning
 } MotorLevels;
 
-class MotorDiagnosticConfigurator : public GenericConfigurator
+/// Fields of the safety, the critical level is in mA on the board
+CONFIG_FIELD(SafetyFieldCritical,    motor_safety_t, "/critical",    critical_zone, double, 1000.0, 0);
+CONFIG_FIELD(SafetyFieldTimeout,     motor_safety_t, "/timeout",     timeout,       int,    1,      0);
+CONFIG_FIELD(SafetyFieldAutorestore, motor_safety_t, "/autorestore", autorestore,   int,    1,      0);
+
+typedef TypedConfigurator<motor_safety_t, SafetyFieldCritical, SafetyFieldTimeout, SafetyFieldAutorestore> SafetyConfigurator;
+
+class MotorDiagnosticConfigurator : public SafetyConfigurator
 {
 public:
     MotorDiagnosticConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, string path, string name, unsigned int type, unsigned int number);
 
+    ~MotorDiagnosticConfigurator();
+
     void initConfigurator();
 
-    void setParam(motor_safety_t safety);
-    /**
-     * @brief getParam from ROSPARAM and save in motor_pid_t function
-     * @return t return the motor_safety_t function
-     */
-    motor_safety_t getParam();
+    void initReconfigure();
 
     MotorLevels levels;
 
@@ -35,21 +35,36 @@
 #include <orbus_interface/UnavEmergencyConfig.h>
 
 #include "hardware/serial_controller.h"
-#include "configurator/GenericConfigurator.h"
+#include "configurator/TypedConfigurator.h"
 
+/// Fields of the emergency
+CONFIG_FIELD(EmergencyFieldSlopeTime, motor_emergency_t, "/Slope_time", slope_time, double, 1, 0);
+CONFIG_FIELD(EmergencyFieldBridgeOff, motor_emergency_t, "/Bridge_off", bridge_off, double, 1, 0);
+CONFIG_FIELD(EmergencyFieldTimeout,   motor_emergency_t, "/Timeout",    timeout,    int,    1, 0);
 
-class MotorEmergencyConfigurator : public GenericConfigurator
+typedef TypedConfigurator<motor_emergency_t, EmergencyFieldSlopeTime, EmergencyFieldBridgeOff, EmergencyFieldTimeout> EmergencyConfigurator;
+
+class MotorEmergencyConfigurator : public EmergencyConfigurator
 {
 public:
     MotorEmergencyConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, std::string name, unsigned int number);
 
-    void initConfigurator();
+    ~MotorEmergencyConfigurator();
 
-    void setParam(motor_emergency_t emergency);
-    motor_emergency_t getParam();
+    void initReconfigure();
+
+    void initConfigurator();
+    /**
+     * @brief timeout Timeout of the board before the emergency stop,
+     * from the last configuration sent or received
+     * @return the timeout in ms
+     */
+    int timeout() const { return timeout_; }
 
 private:
 
+    int timeout_;
+
     motor_emergency_t last_emergency_, default_emer_;
 
     dynamic_reconfigure::Server<orbus_interface::UnavEmergencyConfig> *dsrv_;
@@ -35,11 +35,21 @@
 #include <orbus_interface/UnavPIDConfig.h>
 
 #include "hardware/serial_controller.h"
-#include "configurator/GenericConfigurator.h"
+#include "configurator/TypedConfigurator.h"
 
 using namespace std;
 
-class MotorPIDConfigurator : public GenericConfigurator
+/// Fields of the PID
+CONFIG_FIELD(PIDFieldKp,        motor_pid_t, "/Kp",        kp,        double, 1, 0);
+CONFIG_FIELD(PIDFieldKi,        motor_pid_t, "/Ki",        ki,        double, 1, 0);
+CONFIG_FIELD(PIDFieldKd,        motor_pid_t, "/Kd",        kd,        double, 1, 0);
+CONFIG_FIELD(PIDFieldKaw,       motor_pid_t, "/Kaw",       kaw,       double, 1, 0);
+CONFIG_FIELD(PIDFieldFrequency, motor_pid_t, "/Frequency", frequency, int,    1, 0);
+CONFIG_FIELD(PIDFieldEnable,    motor_pid_t, "/Enable",    enable,    bool,   1, 0);
+
+typedef TypedConfigurator<motor_pid_t, PIDFieldKp, PIDFieldKi, PIDFieldKd, PIDFieldKaw, PIDFieldFrequency, PIDFieldEnable> PIDConfigurator;
+
+class MotorPIDConfigurator : public PIDConfigurator
 {
 public:
     /**
@@ -53,14 +63,9 @@ public:
      */
     MotorPIDConfigurator(const ros::NodeHandle& nh, orbus::serial_controller *serial, string path, string name, unsigned int type, unsigned int number);
 
-    void initConfigurator();
+    ~MotorPIDConfigurator();
 
-    void setParam(motor_pid_t pid);
-    /**
-     * @brief getParam from ROSPARAM and save in motor_pid_t function
-     * @return t return the motor_pid_t function
-     */
-    motor_pid_t getParam();
+    void initReconfigure();
 
 private:
 //    /// Associate name space
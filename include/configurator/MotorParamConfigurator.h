@@ -35,17 +35,38 @@
 #include <orbus_interface/UnavEncoderConfig.h>
 #include <orbus_interface/UnavBridgeConfig.h>
 
-#include "configurator/GenericConfigurator.h"
+#include "configurator/TypedConfigurator.h"
 
-class MotorParamConfigurator : public GenericConfigurator
+/// Fields of the motor parameters
+CONFIG_FIELD(ParamFieldRatio,           motor_parameter_t, "/ratio",                  ratio,                 double, 1, 0);
+CONFIG_FIELD(ParamFieldRotation,        motor_parameter_t, "/rotation",               rotation,              int,    1, 0);
+CONFIG_FIELD(BridgeFieldEnable,         motor_parameter_t, "/bridge/h_bridge_enable", bridge.enable,         int,    1, 0);
+CONFIG_FIELD(BridgeFieldDeadZone,       motor_parameter_t, "/bridge/PWM_dead_zone",   bridge.pwm_dead_zone,  int,    1, 0);
+CONFIG_FIELD(BridgeFieldFrequency,      motor_parameter_t, "/bridge/PWM_frequency",   bridge.pwm_frequency,  int,    1, 0);
+CONFIG_FIELD(BridgeFieldVoltOffset,     motor_parameter_t, "/bridge/volt_offset",     bridge.volt_offset,    double, 1, 0);
+CONFIG_FIELD(BridgeFieldVoltGain,       motor_parameter_t, "/bridge/volt_gain",       bridge.volt_gain,      double, 1, 0);
+CONFIG_FIELD(BridgeFieldCurrentOffset,  motor_parameter_t, "/bridge/current_offset",  bridge.current_offset, double, 1, 0);
+CONFIG_FIELD(BridgeFieldCurrentGain,    motor_parameter_t, "/bridge/current_gain",    bridge.current_gain,   double, 1, 0);
+CONFIG_FIELD(EncoderFieldCPR,           motor_parameter_t, "/encoder/CPR",            encoder.cpr,           int,    1, 0);
+CONFIG_FIELD(EncoderFieldPosition,      motor_parameter_t, "/encoder/position",       encoder.type.position, int,    1, 0);
+CONFIG_FIELD(EncoderFieldZIndex,        motor_parameter_t, "/encoder/z_index",        encoder.type.z_index,  int,    1, 0);
+// On the board the channels are stored from zero
+CONFIG_FIELD(EncoderFieldChannels,      motor_parameter_t, "/encoder/channels",       encoder.type.channels, int,    1, -1);
+
+typedef TypedConfigurator<motor_parameter_t,
+                          ParamFieldRatio, ParamFieldRotation,
+                          BridgeFieldEnable, BridgeFieldDeadZone, BridgeFieldFrequency, BridgeFieldVoltOffset,
+                          BridgeFieldVoltGain, BridgeFieldCurrentOffset, BridgeFieldCurrentGain,
+                          EncoderFieldCPR, EncoderFieldPosition, EncoderFieldZIndex, EncoderFieldChannels> ParamConfigurator;
+
+class MotorParamConfigurator : public ParamConfigurator
 {
 public:
     MotorParamConfigurator(const ros::NodeHandle& nh, orbus::serial_controller *serial, std::string name, unsigned int number);
 
-    void initConfigurator();
+    ~MotorParamConfigurator();
 
-    void setParam(motor_parameter_t parameter);
-    motor_parameter_t getParam();
+    void initReconfigure();
 private:
     /// Setup variable
     bool setup_param, setup_encoder, setup_bridge;
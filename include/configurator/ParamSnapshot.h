@@ -0,0 +1,74 @@
+#ifndef PARAMSNAPSHOT_H
+#define PARAMSNAPSHOT_H
+
+#include <ros/ros.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * @brief The ParamSnapshot class Copy of a namespace of the parameter server,
+ * read with a single call to the master. In the initialization the configurators
+ * read the parameters from the snapshot, instead of one round trip for each
+ * parameter. The dynamic reconfigure servers still read each parameter.
+ */
+class ParamSnapshot
+{
+public:
+    /**
+     * @brief The Key struct Name of a parameter, split in the path
+     * of the snapshot. Build it once with key()
+     */
+    struct Key
+    {
+        /// Full name of the parameter
+        string name;
+        /// Path from the root of the snapshot, empty if outside
+        vector<string> path;
+    };
+
+    ParamSnapshot(const ros::NodeHandle &nh);
+    /**
+     * @brief load Read all the namespace from the parameter server
+     * @return true if the namespace is available
+     */
+    bool load();
+    /**
+     * @brief clear Drop the snapshot, the parameters can be changed after
+     */
+    void clear();
+    /**
+     * @brief isLoaded
+     * @return true if the snapshot is available
+     */
+    bool isLoaded() const { return mLoaded; }
+    /**
+     * @brief key Build the key of a parameter
+     * @param name full name of the parameter
+     * @return the key
+     */
+    Key key(const string &name) const;
+    /**
+     * @brief get Read a parameter from the snapshot, with the same
+     * conversions of the parameter server
+     * @param key the key of the parameter
+     * @param value the value, unchanged if not available
+     * @return true if the parameter is available
+     */
+    bool get(const Key &key, double &value);
+    bool get(const Key &key, int &value);
+    bool get(const Key &key, bool &value);
+
+private:
+    XmlRpc::XmlRpcValue* find(const Key &key);
+
+    // Namespace of the snapshot
+    ros::NodeHandle mNh;
+    // All parameters of the namespace
+    XmlRpc::XmlRpcValue mTree;
+    bool mLoaded;
+};
+
+#endif // PARAMSNAPSHOT_H
@@ -0,0 +1,58 @@
+#ifndef PARAMWRITER_H
+#define PARAMWRITER_H
+
+#include <ros/ros.h>
+
+#include <or_bus/or_message.h>
+
+#include <atomic>
+#include <thread>
+
+class GenericConfigurator;
+
+/// Maximum number of pending writes on the parameter server
+#define PARAM_WRITER_SIZE 32
+
+/**
+ * @brief The ParamWriter class Background worker that updates the
+ * parameter server with the configuration received from the board.
+ * The dispatch path only push the configuration in a bounded lock-free
+ * queue, all XML-RPC calls are done from the worker thread. The worker
+ * also writes on file the configuration cache updated from the dispatch path.
+ * The owner destroys it before the configurators, the destructor joins the worker.
+ */
+class ParamWriter
+{
+public:
+    ParamWriter();
+
+    ~ParamWriter();
+    /**
+     * @brief post Push a new configuration, never blocks
+     * @param target the configurator to update
+     * @param message the configuration received
+     * @return false if the queue is full and the configuration is dropped
+     */
+    bool post(GenericConfigurator *target, const message_abstract_u &message);
+
+private:
+    typedef struct _param_request
+    {
+        std::atomic<unsigned int> sequence;
+        GenericConfigurator *target;
+        message_abstract_u message;
+    } param_request_t;
+
+    bool pop(GenericConfigurator *&target, message_abstract_u &message);
+
+    void worker();
+
+    // Bounded multi producer queue
+    param_request_t mQueue[PARAM_WRITER_SIZE];
+    std::atomic<unsigned int> mHead, mTail;
+    // Worker thread
+    std::atomic<bool> mRunning;
+    std::thread mThread;
+};
+
+#endif // PARAMWRITER_H
@@ -0,0 +1,153 @@
+#ifndef TYPEDCONFIGURATOR_H
+#define TYPEDCONFIGURATOR_H
+
+#include "configurator/GenericConfigurator.h"
+
+#include <cstring>
+#include <type_traits>
+
+/**
+ * Declare a field of a configuration: the name of the parameter, the member
+ * of the struct and the type on the parameter server. The value sent
+ * to the board is: member = parameter * scale + offset
+ */
+#define CONFIG_FIELD(name_, struct_, key_, member_, param_, scale_, offset_)                \
+    struct name_                                                                            \
+    {                                                                                       \
+        typedef struct_ struct_t;                                                           \
+        typedef param_ param_t;                                                             \
+        static const char *key() { return key_; }                                           \
+        static void set(struct_t &value, param_t param)                                     \
+        {                                                                                   \
+            value.member_ = (decltype(value.member_)) (((double) param) * (scale_) + (offset_)); \
+        }                                                                                   \
+        static param_t get(const struct_t &value)                                           \
+        {                                                                                   \
+            return (param_t) ((((double) value.member_) - (offset_)) / (scale_));           \
+        }                                                                                   \
+    }
+
+/**
+ * @brief The TypedConfigurator class Configurator of a struct of the board
+ * described from a list of fields. Read, write and compare the configuration
+ * are generated from the fields, all keys are built once.
+ */
+template <typename Struct, typename... Fields>
+class TypedConfigurator : public GenericConfigurator
+{
+public:
+    TypedConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, unsigned int number)
+        : GenericConfigurator(nh, serial, number)
+    {
+    }
+
+    virtual void initConfigurator()
+    {
+        Struct value = getParam();
+        // Skip if the board has the same configuration
+        if(isSynced(&value, sizeof(value)))
+        {
+            return;
+        }
+        /// Send configuration to board
+        SendParameterToBoard(toMessage(value), false);
+    }
+    /**
+     * @brief setParam Update the parameter server with a configuration from the board
+     * @param value the configuration
+     */
+    void setParam(const Struct &value)
+    {
+        // Update the parameter server in background
+        postParam(toMessage(value));
+    }
+    /**
+     * @brief getParam Read the configuration from the parameter server
+     * @return the configuration, the fields not available are zero
+     */
+    Struct getParam()
+    {
+        Struct value;
+        // Clean all padding, the struct is hashed from the configuration cache
+        memset(&value, 0, sizeof(value));
+        fetch<0, Fields...>(value);
+        return value;
+    }
+
+protected:
+    /**
+     * @brief initKeys Build the keys of all fields, call after mName is set
+     */
+    void initKeys()
+    {
+        const char *names[] = { Fields::key()... };
+        for(size_t i = 0; i < sizeof...(Fields); ++i)
+        {
+            keys_[i] = paramKey(names[i]);
+        }
+    }
+    /**
+     * @brief updateParam Send a new configuration from dynamic reconfigure
+     * @param value the configuration
+     */
+    void updateParam(const Struct &value)
+    {
+        /// Call the function in Generic Reconfigurator
+        UpdateParameterToBoard(toMessage(value), sizeof(value));
+    }
+    /**
+     * @brief toMessage Copy the configuration in a message, all members
+     * of the message start at the same address
+     * @param value the configuration
+     * @return the message
+     */
+    static message_abstract_u toMessage(const Struct &value)
+    {
+        static_assert(sizeof(Struct) <= sizeof(message_abstract_u), "Configuration larger than the message");
+        message_abstract_u message;
+        memcpy(&message, &value, sizeof(value));
+        return message;
+    }
+
+    void writeParam(const message_abstract_u &message)
+    {
+        Struct value;
+        memcpy(&value, &message, sizeof(value));
+        publish<0, Fields...>(value);
+    }
+
+    /// Keys of all fields
+    ParamSnapshot::Key keys_[sizeof...(Fields)];
+
+private:
+    template <size_t I>
+    void fetch(Struct &value) { }
+
+    template <size_t I, typename Field, typename... Rest>
+    void fetch(Struct &value)
+    {
+        static_assert(std::is_same<typename Field::struct_t, Struct>::value, "Field of another configuration");
+        typename Field::param_t param;
+        if(readParam(keys_[I], param))
+        {
+            Field::set(value, param);
+        }
+        else
+        {
+            ROS_WARN_STREAM("PARAM:" << keys_[I].name << " not available");
+        }
+        fetch<I + 1, Rest...>(value);
+    }
+
+    template <size_t I>
+    void publish(const Struct &value) { }
+
+    template <size_t I, typename Field, typename... Rest>
+    void publish(const Struct &value)
+    {
+        nh_.setParam(keys_[I].name, Field::get(value));
+        publish<I + 1, Rest...>(value);
+    }
+};
+
+#endif // TYPEDCONFIGURATOR_H
@@ -0,0 +1,92 @@
+#ifndef ADAPTIVERATE_H
+#define ADAPTIVERATE_H
+
+#include <ros/ros.h>
+
+namespace ORInterface
+{
+
+/**
+ * @brief The AdaptiveRate class Rate of the control loop on a degraded link.
+ * Evaluated on each diagnostic cycle: when the link or the board is saturated
+ * the rate goes down one level, after some healthy cycles it goes up one level.
+ * The first levels slow down only the telemetry, the next ones halve the
+ * rate of the control loop until the minimum frequency.
+ */
+class AdaptiveRate
+{
+public:
+    AdaptiveRate();
+    /**
+     * @brief setup Load the parameters in adaptive_rate
+     * @param nh namespace of the parameters
+     * @param frequency nominal frequency of the control loop
+     */
+    void setup(const ros::NodeHandle &nh, double frequency);
+    /**
+     * @brief update Evaluate the link from the last diagnostic cycle
+     * @param latency maximum time of the transactions of a control cycle [s]
+     * @param failures transactions without answer from the last update
+     * @param idle idle of the board [%], negative if not available
+     * @return true if the level is changed
+     */
+    bool update(double latency, unsigned long failures, double idle);
+    /**
+     * @brief lost The link is lost, go to the minimum rate
+     * @return true if the level is changed
+     */
+    bool lost();
+    /**
+     * @brief limit Raise the minimum frequency over a limit of the board,
+     * the minimum configured is used if higher
+     * @param frequency lowest safe frequency of the control loop
+     * @return true if the minimum frequency is changed
+     */
+    bool limit(double frequency);
+
+    bool enabled() const { return mEnable; }
+
+    unsigned int level() const { return mLevel; }
+    /// Effective frequency of the control loop
+    double frequency() const;
+    /// Nominal frequency of the control loop
+    double nominal() const { return mNominal; }
+    /// Minimum frequency of the control loop, after the limit
+    double minimum() const { return mMinimum; }
+    /// Factor on the divisor of the telemetry streams
+    unsigned int telemetryScale() const;
+    /// Cause of the last change
+    const std::string &reason() const { return mReason; }
+
+private:
+    /**
+     * @brief setLevel Change the level
+     * @param level new level
+     * @param reason cause of the change
+     * @return true if the level is changed
+     */
+    bool setLevel(unsigned int level, const std::string &reason);
+    /**
+     * @brief updateLevels Number of levels from the minimum frequency
+     */
+    void updateLevels();
+
+    bool mEnable;
+    // Nominal, configured and effective minimum frequency of the control loop
+    double mNominal, mConfigured, mMinimum;
+    // Fraction of the control period for the transactions
+    double mLatencyLimit;
+    // Minimum idle of the board
+    double mIdleMin;
+    // Healthy cycles before to go up one level
+    unsigned int mRecover;
+    // Levels on the telemetry, before to slow down the control loop
+    unsigned int mTelemetrySteps;
+    // Current and maximum level, healthy cycles counted
+    unsigned int mLevel, mMaxLevel, mHealthy;
+    std::string mReason;
+};
+
+}
+
+#endif // ADAPTIVERATE_H
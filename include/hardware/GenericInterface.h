@@ -9,8 +9,13 @@
 #include <orbus_interface/Service.h>
 #include <orbus_interface/BoardTime.h>
 #include <orbus_interface/Peripheral.h>
+#include <std_msgs/Bool.h>
 
 #include "hardware/serial_controller.h"
+#include "hardware/frame_descriptor.h"
+#include "hardware/StreamScheduler.h"
+#include "hardware/LoadThrottle.h"
+#include "hardware/TopicGate.h"
 
 namespace ORInterface
 {
@@ -24,10 +29,21 @@ public:
 
     void run(diagnostic_updater::DiagnosticStatusWrapper &stat);
 
+    /**
+     * @brief updateInterface Queue the GPIO and load requests, when scheduled.
+     * The frames are sent with the next transaction
+     */
     void updateInterface();
 
 protected:
 
+    /**
+     * @brief requestIdentity Request the name, version and author of the firmware.
+     * Does not use the parameter server, can run in parallel with the configuration of the motors.
+     * @return true if the board answered
+     */
+    bool requestIdentity();
+
     /**
      * @brief initialize Initialization all parts
      */
@@ -38,6 +54,11 @@ protected:
      * @param pub information about the publisher
      */
     void connectionCallback(const ros::SingleSubscriberPublisher& pub);
+    /**
+     * @brief boardIdle Idle time of the board from the last SYSTEM_TIME frame
+     * @return the idle in %, negative if never received
+     */
+    double boardIdle() const;
     //Initialization object
     //NameSpace for bridge controller
     ros::NodeHandle mNh;
@@ -50,6 +71,10 @@ protected:
     string code_date, code_version, code_author, code_board_type, code_board_name;
     // List of messages to send to the board
     vector<packet_information_t> information_frames;
+    // Rate of each stream of frames in the control loop
+    StreamScheduler mScheduler;
+    // Throttle of the low priority streams from the load of the board
+    LoadThrottle mThrottle;
 private:
     /**
      * @brief systemFrame
@@ -58,7 +83,7 @@ private:
      * @param command
      * @param message
      */
-    void systemFrame(unsigned char option, unsigned char type, unsigned char command, message_abstract_u message);
+    void systemFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message);
 
     /**
      * @brief peripheralFrame
@@ -67,7 +92,7 @@ private:
      * @param command
      * @param message
      */
-    void peripheralFrame(unsigned char option, unsigned char type, unsigned char command, message_abstract_u message);
+    void peripheralFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message);
 
     void setupGPIO(std::vector<int> gpio_list);
 
@@ -92,11 +117,14 @@ private:
     // time execution functions
     ros::Publisher pub_time;
     ros::Publisher pub_peripheral;
+    ros::Publisher pub_throttle;
+    TopicGate gate_time, gate_peripheral;
     // Subscriber peripherals
     ros::Subscriber sub_peripheral;
     // Message for pubblisher
     orbus_interface::BoardTime msg_system;
     orbus_interface::Peripheral msg_peripheral;
+    std_msgs::Bool msg_throttle;
 
     peripheral_gpio_map_t gpio_map;
     std::vector<int> gpio_list;
@@ -0,0 +1,72 @@
+#ifndef JOINTESTIMATOR_H
+#define JOINTESTIMATOR_H
+
+#include <ros/ros.h>
+
+#include <stdint.h>
+
+namespace ORInterface
+{
+
+/**
+ * @brief The JointEstimator class Latency compensated state of a joint.
+ * All position deltas from the board are accumulated in fixed point,
+ * in this way the sum is exact and does not drift after hours of work.
+ * An alpha-beta filter tracks the position: the residual on the predicted
+ * position corrects the position with alpha and the velocity with beta / dt.
+ * The velocity from the board is a second measure of the same state, after
+ * the correction it is blended in the velocity with its own gain.
+ * The state is extrapolated to the time required by the controller manager.
+ */
+class JointEstimator
+{
+public:
+    JointEstimator();
+    /**
+     * @brief setup Configure the filter
+     * @param alpha gain of the position residual on the position [0, 1]
+     * @param beta gain of the position residual on the velocity [0, 1]
+     * @param velocity_gain weight of the velocity measured from the board [0, 1],
+     * zero to use only the position
+     * @param max_horizon maximum extrapolation time in seconds
+     */
+    void setup(double alpha, double beta, double velocity_gain, double max_horizon);
+    /**
+     * @brief reset Move the estimator in a new position
+     * @param position new position in rad
+     */
+    void reset(double position);
+    /**
+     * @brief update Fuse a new measure from the board
+     * @param position_delta delta position from the last measure [rad]
+     * @param velocity velocity measured from the board [rad/s]
+     * @param stamp acquisition time of the measure
+     */
+    void update(double position_delta, double velocity, const ros::Time& stamp);
+    /**
+     * @brief predict Extrapolate the state at the required time
+     * @param stamp time to extrapolate
+     * @param position estimated position [rad]
+     * @param velocity estimated velocity [rad/s]
+     */
+    void predict(const ros::Time& stamp, double &position, double &velocity) const;
+
+private:
+    // Fixed point resolution of the accumulator 1e-9 rad
+    static const double TICK;
+    // Accumulated raw position from the board in ticks
+    int64_t mTicks;
+    // Filter state at the last acquisition time
+    double mPosition, mVelocity;
+    ros::Time mStamp;
+    // Filter gains
+    double mAlpha, mBeta, mVelocityGain;
+    // Maximum extrapolation horizon
+    double mMaxHorizon;
+    // True after the first measure
+    bool mValid;
+};
+
+}
+
+#endif // JOINTESTIMATOR_H
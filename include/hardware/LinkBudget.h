@@ -0,0 +1,96 @@
+#ifndef LINKBUDGET_H
+#define LINKBUDGET_H
+
+#include <ros/ros.h>
+
+#include "hardware/StreamScheduler.h"
+
+namespace ORInterface
+{
+
+/// Result of the plan of the serial link
+typedef enum link_status
+{
+    LINK_OK,                ///< All streams fit in the link
+    LINK_WARNING,           ///< Utilization over the limit or some cycles late
+    LINK_OVERLOAD           ///< On average the streams need more time than the control period
+} link_status_t;
+
+/**
+ * @brief The LinkBudget class Time on the serial link required from all
+ * streams of the control loop. From the bytes of the frames of each stream,
+ * the baudrate and the turnaround of the board, plan the bytes for each
+ * cycle, the utilization of the link and the maximum control rate.
+ */
+class LinkBudget
+{
+public:
+    LinkBudget();
+    /**
+     * @brief setup Load the parameters link_budget/limit and link_budget/mode
+     * @param nh namespace of the parameters
+     * @param baudrate baudrate of the serial port
+     * @param frequency frequency of the control loop
+     */
+    void setup(const ros::NodeHandle &nh, unsigned long baudrate, double frequency);
+    /**
+     * @brief setStream Bytes of a stream in a cycle where it is sent
+     * @param stream the stream
+     * @param tx bytes of the frames sent to the board
+     * @param rx bytes of the frames received from the board
+     * @param divisor divisor of the stream from the scheduler
+     */
+    void setStream(stream_t stream, size_t tx, size_t rx, unsigned int divisor);
+    /**
+     * @brief setFrequency Change the frequency of the control loop
+     * @param frequency the new frequency
+     */
+    void setFrequency(double frequency) { mFrequency = frequency; }
+    /**
+     * @brief plan Evaluate the link with all streams
+     * @param turnaround measured turnaround of the board, zero to use the default
+     * @return the status of the link
+     */
+    link_status_t plan(double turnaround);
+    /**
+     * @brief refuse
+     * @return true if the node must not start over budget
+     */
+    bool refuse() const { return mRefuse; }
+
+    link_status_t status() const { return mStatus; }
+    /// Average bytes on the link for each cycle, both directions
+    double bytesPerCycle() const { return mBytes; }
+    /// Average fraction of the control period used from the link
+    double utilization() const { return mUtilization; }
+    /// Maximum control rate with all streams in the same cycle
+    double maxRate() const { return mMaxRate; }
+    /// Turnaround used in the last plan
+    double turnaround() const { return mTurnaround; }
+
+private:
+    /**
+     * @brief cycleTime Time on the link of the two transactions of a cycle
+     * @param read_bytes bytes of the read transaction
+     * @param write_bytes bytes of the write transaction
+     * @return the time in seconds
+     */
+    double cycleTime(double read_bytes, double write_bytes) const;
+
+    // Bytes of each stream, sent and received
+    size_t mTx[STREAM_SIZE], mRx[STREAM_SIZE];
+    unsigned int mDivisor[STREAM_SIZE];
+    // Link configuration
+    unsigned long mBaudrate;
+    double mFrequency;
+    // Utilization limit before the warning and default turnaround
+    double mLimit, mDefaultTurnaround;
+    bool mRefuse;
+    // Last plan
+    link_status_t mStatus;
+    double mBytes, mUtilization, mMaxRate, mTurnaround;
+};
+
+}
+
+#endif // LINKBUDGET_H
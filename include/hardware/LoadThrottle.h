@@ -0,0 +1,63 @@
+#ifndef LOADTHROTTLE_H
+#define LOADTHROTTLE_H
+
+#include <ros/ros.h>
+
+namespace ORInterface
+{
+
+/**
+ * @brief The LoadThrottle class Feedback from the load of the board.
+ * The throttle starts when the idle of the board goes under the minimum
+ * or the time of the serial parser goes over its average, and stops only
+ * when both are back inside the hysteresis.
+ * A single spike does not move the average of the parser, a spike
+ * sustained for some frames is the new load and enters the average.
+ */
+class LoadThrottle
+{
+public:
+    LoadThrottle();
+    /**
+     * @brief setup Load the parameters in board_load
+     * @param nh namespace of the parameters
+     */
+    void setup(const ros::NodeHandle &nh);
+    /**
+     * @brief update Evaluate a new SYSTEM_TIME frame
+     * @param idle idle of the board [%]
+     * @param parser execution time of the serial parser [nS]
+     * @return true if the throttle is changed
+     */
+    bool update(double idle, double parser);
+    /**
+     * @brief active
+     * @return true if the low priority streams must be throttled
+     */
+    bool active() const { return mActive; }
+    /**
+     * @brief scale
+     * @return factor on the divisor of the low priority streams
+     */
+    unsigned int scale() const { return mActive ? mScale : 1; }
+    /// Average time of the serial parser, without spikes
+    double parserAverage() const { return mParser; }
+
+private:
+    bool mEnable;
+    // Minimum idle and spike of the parser on the average
+    double mIdleMin, mParserSpike;
+    // Fraction of the thresholds to release the throttle
+    double mHysteresis;
+    // Consecutive spikes before they enter the average, and counter
+    unsigned int mSustain, mSpikes;
+    // Factor on the low priority streams
+    unsigned int mScale;
+    // Average of the parser
+    double mParser;
+    bool mActive;
+};
+
+}
+
+#endif // LOADTHROTTLE_H
@@ -15,7 +15,13 @@
 
 #include <orbus_interface/UnavLimitsConfig.h>
 
+#include <std_srvs/Empty.h>
+
 #include "hardware/serial_controller.h"
+#include "hardware/frame_descriptor.h"
+#include "hardware/JointEstimator.h"
+#include "hardware/SafetyMonitor.h"
+#include "hardware/TopicGate.h"
 
 #include "configurator/MotorPIDConfigurator.h"
 #include "configurator/MotorParamConfigurator.h"
@@ -27,36 +33,108 @@ using namespace std;
 namespace ORInterface
 {
 
+/// Maximum number of motors in a board
+#define MAX_MOTORS 8
+
+/**
+ * @brief The joint_table struct Hot state of all joints of a board,
+ * stored as struct of arrays and indexed by motor number
+ */
+typedef struct _joint_table
+{
+    double position[MAX_MOTORS];
+    double velocity[MAX_MOTORS];
+    double effort[MAX_MOTORS];
+    double command[MAX_MOTORS];
+    motor_state_t state[MAX_MOTORS];
+} joint_table_t;
+
 class Motor : public diagnostic_updater::DiagnosticTask
 {
 public:
-    explicit Motor(const ros::NodeHandle &nh, orbus::serial_controller *serial, string name, unsigned int number);
+    explicit Motor(const ros::NodeHandle &nh, orbus::serial_controller *serial, joint_table_t *table, string name, unsigned int number);
+
+    ~Motor();
 
     void initializeMotor();
+    /**
+     * @brief initReconfigure Start the dynamic reconfigure servers of this motor
+     */
+    void initReconfigure();
 
     void run(diagnostic_updater::DiagnosticStatusWrapper &stat);
 
-    void motorFrame(unsigned char option, unsigned char type, unsigned char command, motor_frame_u frame);
-
-    void addRequestMeasure();
+    void motorFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message);
+
+    /**
+     * @brief addRequestMeasure Queue the requests of the measures
+     * @param measure request the measure
+     * @param telemetry request reference and control, if subscribed
+     * @param acquisition estimated time of the measure on the board
+     */
+    void addRequestMeasure(bool measure, bool telemetry, const ros::Time &acquisition);
+    /**
+     * @brief measure Last measure from the board
+     * @return the measure, without header
+     */
+    const orbus_interface::ControlStatus &measure();
+    /**
+     * @brief telemetryFrames
+     * @return number of telemetry frames requested, one for each topic subscribed
+     */
+    size_t telemetryFrames() const { return information_motor.size(); }
 
     void resetPosition(double position);
 
-    void switchController(string type);
+    /**
+     * @brief stateFrame Build the frame to change the state of the motor
+     * @param state the new state
+     * @return the frame
+     */
+    packet_information_t stateFrame(motor_state_t state) const;
+    /**
+     * @brief setState Set the state of the motor, after the board has accepted it
+     * @param state the new state
+     */
+    void setState(motor_state_t state);
+    /**
+     * @brief get_state State of the motor required from a controller
+     * @param type type of the controller
+     * @return the state
+     */
+    static motor_state_t get_state(string type);
 
     void writeCommandsToHardware(ros::Duration period);
 
-    void setupLimits(urdf::Model model);
-
+    void setupLimits(const urdf::Model &model);
+    /**
+     * @brief updateEstimate Extrapolate the joint state at the time the next
+     * command is applied by the board. Does nothing if the estimator is disabled
+     * @param time application time of the command
+     */
+    void updateEstimate(const ros::Time& time);
+    /**
+     * @brief safetyLevel Worst level of current and temperature
+     * @return the level
+     */
+    safety_level_t safetyLevel() const;
+    /**
+     * @brief emergencyRequired
+     * @return true if a critical level requires the emergency stop
+     */
+    bool emergencyRequired() const;
+    /**
+     * @brief emergencyTimeout Time without commands before the board stops the motor
+     * @return the timeout in seconds
+     */
+    double emergencyTimeout() const;
 
 
     hardware_interface::JointStateHandle joint_state_handle;
     hardware_interface::JointHandle joint_handle;
 
 private:
-    static string convert_status(motor_state_t status);
-
-    static motor_state_t get_state(string type);
+    static const char *convert_status(motor_state_t status);
 
     void updateLimits(double position, double velocity, double effort);
 
@@ -64,6 +142,14 @@ private:
 
     void connectionCallback(const ros::SingleSubscriberPublisher& pub);
 
+    void safetyEvent(const char *name, safety_level_t level, double value);
+    /**
+     * @brief convertMeasure Build the measure message from the last frame
+     */
+    void convertMeasure();
+
+    bool reconfigure_Callback(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+
 private:
     //Initialization object
     //NameSpace for bridge controller
@@ -73,15 +159,33 @@ private:
     // Name of the motor
     string mMotorName;
     unsigned int mNumber;
-    // State of the motor
-    motor_state_t mState, mDiagnosticState;
-    double position, max_position;
-    double velocity, max_velocity;
-    double effort, max_effort;
-    double command;
+    // State of the motor, stored in the joint table
+    motor_state_t &mState;
+    double &position;
+    double &velocity;
+    double &effort;
+    double &command;
+    motor_state_t mDiagnosticState;
+    double max_position, max_velocity, max_effort;
 
     vector<packet_information_t> information_motor;
 
+    // Latency compensated estimator
+    bool estimator_enable;
+    JointEstimator estimator;
+
+    // Host side safety, checked on each frame
+    SafetyMonitor current_safety, temperature_safety;
+    safety_reaction_t safety_reaction;
+    double safety_derate;
+
+    // Suppression of the references not changed, sent again after the keepalive
+    bool command_dedup, command_valid;
+    double command_keepalive;
+    motor_control_t last_reference;
+    ros::Time last_sent;
+    unsigned long commands_sent, commands_suppressed;
+
     // Reconfigure status
     orbus_interface::UnavLimitsConfig limits;
     bool first;
@@ -91,12 +195,14 @@ private:
 
     // Publisher diagnostic information
     ros::Publisher pub_status, pub_control, pub_measure, pub_reference;
+    TopicGate gate_status, gate_measure;
+    // Last measure from the board, converted only to publish
+    orbus::frame_descriptor<HASHMAP_MOTOR, MOTOR_MEASURE>::payload_t last_measure;
+    // Acquisition time of the measure requested, zero if not requested
+    ros::Time measure_stamp;
     // Message
     orbus_interface::MotorStatus msg_status;
     orbus_interface::ControlStatus msg_reference, msg_measure, msg_control;
-
-    // Number message
-    motor_command_map_t motor_command;
     /// Load all configurators
     MotorPIDConfigurator *pid_velocity, *pid_current;
     MotorParamConfigurator *parameter;
@@ -106,6 +212,9 @@ private:
     // Dynamic reconfigurator for limits
     dynamic_reconfigure::Server<orbus_interface::UnavLimitsConfig> *dsrv;
     boost::recursive_mutex config_mutex;
+    // Start the dynamic reconfigure servers on request
+    bool lazy_reconfigure;
+    ros::ServiceServer srv_reconfigure;
     /// Setup variable
     bool setup_;
     orbus_interface::UnavLimitsConfig last_config_, default_config_;
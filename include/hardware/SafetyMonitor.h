@@ -0,0 +1,90 @@
+#ifndef SAFETYMONITOR_H
+#define SAFETYMONITOR_H
+
+namespace ORInterface
+{
+
+/// Level of a monitored value
+typedef enum safety_level
+{
+    SAFETY_OK,
+    SAFETY_WARNING,
+    SAFETY_CRITICAL
+} safety_level_t;
+
+/// Reaction of the host on a critical level
+typedef enum safety_reaction
+{
+    SAFETY_REACTION_WARN,       ///< Only log
+    SAFETY_REACTION_DERATE,     ///< Scale the command sent to the motor
+    SAFETY_REACTION_ESTOP       ///< Emergency stop of all motors
+} safety_reaction_t;
+
+/**
+ * @brief The SafetyMonitor class Check a value against the warning and
+ * critical levels on every frame. The level rises immediately and goes
+ * back only when the value is under the threshold minus the hysteresis.
+ * Only comparisons, can run on each measure.
+ */
+class SafetyMonitor
+{
+public:
+    SafetyMonitor()
+        : mLevel(SAFETY_OK)
+        , mRelease(0.95)
+    {
+    }
+    /**
+     * @brief setup Configure the hysteresis
+     * @param hysteresis fraction of the threshold [0, 1)
+     */
+    void setup(double hysteresis)
+    {
+        if(hysteresis < 0 || hysteresis >= 1)
+        {
+            hysteresis = 0;
+        }
+        mRelease = 1.0 - hysteresis;
+    }
+    /**
+     * @brief update Evaluate a new value
+     * @param value the value
+     * @param warning warning threshold
+     * @param critical critical threshold
+     * @return the new level
+     */
+    inline safety_level_t update(double value, double warning, double critical)
+    {
+        safety_level_t level = (value > critical ? SAFETY_CRITICAL : (value > warning ? SAFETY_WARNING : SAFETY_OK));
+        if(level >= mLevel)
+        {
+            mLevel = level;
+            return mLevel;
+        }
+        // Go back one level at time, only under the hysteresis
+        if(mLevel == SAFETY_CRITICAL && value < critical * mRelease)
+        {
+            mLevel = SAFETY_WARNING;
+        }
+        if(mLevel == SAFETY_WARNING && value < warning * mRelease)
+        {
+            mLevel = SAFETY_OK;
+        }
+        return mLevel;
+    }
+    /**
+     * @brief level
+     * @return the last level
+     */
+    safety_level_t level() const { return mLevel; }
+
+private:
+    // Last level
+    safety_level_t mLevel;
+    // Fraction of the threshold to go back
+    double mRelease;
+};
+
+}
+
+#endif // SAFETYMONITOR_H
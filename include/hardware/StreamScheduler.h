@@ -0,0 +1,85 @@
+#ifndef STREAMSCHEDULER_H
+#define STREAMSCHEDULER_H
+
+#include <ros/ros.h>
+
+namespace ORInterface
+{
+
+/// Streams of frames sent in the control loop
+typedef enum stream
+{
+    STREAM_COMMAND,         ///< References to the motors
+    STREAM_MEASURE,         ///< Measures of the motors
+    STREAM_TELEMETRY,       ///< Reference and control of the motors, on subscription
+    STREAM_GPIO,            ///< GPIO port, on subscription
+    STREAM_SYSTEM,          ///< Load of the board, for the throttle
+    STREAM_SIZE
+} stream_t;
+
+/**
+ * @brief The StreamScheduler class Rate of each stream of frames, as
+ * divisor of the control loop. The streams with the same divisor are
+ * staggered on different cycles, the size of each packet stays flat.
+ */
+class StreamScheduler
+{
+public:
+    StreamScheduler();
+    /**
+     * @brief setup Load the divisors from the parameters scheduler/<stream>_divisor
+     * @param nh namespace of the parameters
+     */
+    void setup(const ros::NodeHandle &nh);
+    /**
+     * @brief tick Move to the next control cycle
+     */
+    void tick();
+    /**
+     * @brief due Check if the stream is sent in this cycle
+     * @param stream the stream
+     * @param index index of the element of the stream, to stagger the motors
+     * @return true if the stream is sent
+     */
+    bool due(stream_t stream, unsigned int index = 0) const;
+    /**
+     * @brief divisor
+     * @param stream the stream
+     * @return the divisor of the stream, with the scale
+     */
+    unsigned int divisor(stream_t stream) const;
+    /**
+     * @brief setScale Slow down a stream without change its configuration
+     * @param stream the stream
+     * @param scale factor on the divisor, 1 for the configured rate
+     */
+    void setScale(stream_t stream, unsigned int scale);
+    /**
+     * @brief setThrottle Slow down all low priority streams, telemetry and GPIO
+     * @param throttle factor on the divisor, 1 without throttle
+     */
+    void setThrottle(unsigned int throttle);
+
+    static const char *name(stream_t stream);
+
+private:
+    /**
+     * @brief period Cycles between two frames of the stream
+     * @param stream the stream
+     * @return the period in cycles
+     */
+    unsigned int period(stream_t stream) const;
+
+    // Control cycles from the start
+    unsigned long mTick;
+    // Divisor, phase and scale of each stream
+    unsigned int mDivisor[STREAM_SIZE];
+    unsigned int mScale[STREAM_SIZE];
+    // Factor on the low priority streams
+    unsigned int mThrottle;
+    unsigned int mPhase[STREAM_SIZE];
+};
+
+}
+
+#endif // STREAMSCHEDULER_H
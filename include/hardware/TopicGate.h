@@ -0,0 +1,58 @@
+#ifndef TOPICGATE_H
+#define TOPICGATE_H
+
+#include <ros/ros.h>
+
+namespace ORInterface
+{
+
+/**
+ * @brief The TopicGate class Publish a topic only with subscribers and only
+ * one message every decimation. Checked before to build the message,
+ * without subscribers the message is not built at all.
+ */
+class TopicGate
+{
+public:
+    TopicGate()
+        : mDecimation(1)
+        , mCount(0)
+    {
+    }
+    /**
+     * @brief setup Load the decimation of the topic
+     * @param nh namespace of the parameter
+     * @param param name of the parameter, 1 to publish all messages
+     */
+    void setup(const ros::NodeHandle &nh, const std::string &param)
+    {
+        int decimation;
+        nh.param<int>(param, decimation, 1);
+        mDecimation = (decimation > 0 ? decimation : 1);
+    }
+    /**
+     * @brief due Check if the next message is published
+     * @param pub publisher of the topic
+     * @return true if the message must be built and published
+     */
+    inline bool due(const ros::Publisher &pub)
+    {
+        if(pub.getNumSubscribers() == 0)
+        {
+            // The first message after a new subscription is published
+            mCount = 0;
+            return false;
+        }
+        return (mCount++ % mDecimation) == 0;
+    }
+
+private:
+    // Publish one message every decimation
+    unsigned int mDecimation;
+    // Messages received from the first subscription
+    unsigned long mCount;
+};
+
+}
+
+#endif // TOPICGATE_H
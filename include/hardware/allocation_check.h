@@ -0,0 +1,54 @@
+#ifndef ALLOCATION_CHECK_H
+#define ALLOCATION_CHECK_H
+
+/**
+ * Allocation tracking for the control loop.
+ * When the package is built with ALLOCATION_CHECK all heap allocations
+ * made from the calling thread between arm() and disarm() are counted.
+ * With ALLOCATION_CHECK_ABORT, set on the debug builds, the first allocation
+ * aborts the process with the stack of the allocation.
+ * Without the flag all functions do nothing.
+ */
+namespace orbus
+{
+namespace allocation
+{
+
+#ifdef ALLOCATION_CHECK
+/**
+ * @brief arm Start to count the allocations on this thread
+ */
+void arm();
+/**
+ * @brief disarm Stop to count the allocations on this thread
+ * @return number of allocations from arm()
+ */
+unsigned long disarm();
+
+/**
+ * @brief The pause class The allocations in its scope are not checked:
+ * publishers and logs of the events, they are not part of the realtime path
+ */
+class pause
+{
+public:
+    pause();
+    ~pause();
+private:
+    bool mArmed;
+};
+#else
+inline void arm() { }
+inline unsigned long disarm() { return 0; }
+
+class pause
+{
+public:
+    pause() { }
+};
+#endif
+
+}
+}
+
+#endif // ALLOCATION_CHECK_H
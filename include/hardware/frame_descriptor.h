@@ -0,0 +1,159 @@
+#ifndef FRAME_DESCRIPTOR_H
+#define FRAME_DESCRIPTOR_H
+
+#include <or_bus/or_message.h>
+#include <or_bus/or_frame.h>
+
+#include <cstddef>
+#include <cstring>
+
+namespace orbus
+{
+
+/// Direction of a frame, seen from the host
+typedef enum frame_direction
+{
+    FRAME_TX = 1,                       ///< Data sent to the board
+    FRAME_RX = 2,                       ///< Data requested from the board
+    FRAME_TX_RX = FRAME_TX | FRAME_RX   ///< Both
+} frame_direction_t;
+
+/**
+ * @brief The frame_descriptor struct Description of a frame for each
+ * (hashmap, command) pair. A pair without descriptor does not compile.
+ */
+template <unsigned char Hashmap, unsigned char Command>
+struct frame_descriptor;
+
+/// Type of the member of the message union
+#define ORBUS_PAYLOAD(member) decltype(((message_abstract_u*) 0)->member)
+
+/// Declare a new frame descriptor
+#define ORBUS_FRAME_DESCRIPTOR(hashmap_, command_, member_, direction_)              \
+    template <> struct frame_descriptor<hashmap_, command_>                         \
+    {                                                                               \
+        typedef ORBUS_PAYLOAD(member_) payload_t;                                   \
+        static constexpr unsigned char hashmap = hashmap_;                          \
+        static constexpr unsigned char command = command_;                          \
+        static constexpr size_t size = sizeof(payload_t);                           \
+        static constexpr frame_direction_t direction = direction_;                  \
+    }
+
+// Motor frames
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_MEASURE,     motor.motor,      FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_CONTROL,     motor.motor,      FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_REFERENCE,   motor.motor,      FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_DIAGNOSTIC,  motor.diagnostic, FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_CONSTRAINT,  motor.motor,      FRAME_TX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_STATE,       motor.state,      FRAME_TX_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_VEL_REF,     motor.reference,  FRAME_TX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_CURRENT_REF, motor.reference,  FRAME_TX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_POS_RESET,   motor.reference,  FRAME_TX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_VEL_PID,     motor.pid,        FRAME_TX_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_CURRENT_PID, motor.pid,        FRAME_TX_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_PARAMETER,   motor.parameter,  FRAME_TX_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_EMERGENCY,   motor.emergency,  FRAME_TX_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_MOTOR, MOTOR_SAFETY,      motor.safety,     FRAME_TX_RX);
+// System frames
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_SYSTEM, SYSTEM_TIME,            system.time,    FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_SYSTEM, SYSTEM_CODE_DATE,       system.service, FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_SYSTEM, SYSTEM_CODE_VERSION,    system.service, FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_SYSTEM, SYSTEM_CODE_AUTHOR,     system.service, FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_SYSTEM, SYSTEM_CODE_BOARD_TYPE, system.service, FRAME_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_SYSTEM, SYSTEM_CODE_BOARD_NAME, system.service, FRAME_RX);
+// Peripheral frames
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_PERIPHERALS, PERIPHERALS_GPIO_DIGITAL, gpio.port, FRAME_TX_RX);
+ORBUS_FRAME_DESCRIPTOR(HASHMAP_PERIPHERALS, PERIPHERALS_GPIO_SET,     gpio.set,  FRAME_TX);
+
+/// Size of the header of a frame before the payload
+#define ORBUS_FRAME_HEADER offsetof(packet_information_t, message)
+
+/**
+ * @brief The frame_command struct Full command of a frame for each hashmap.
+ * The system frames have only the command
+ */
+template <unsigned char Hashmap>
+struct frame_command
+{
+    static unsigned char build(unsigned char index, unsigned char command)
+    {
+        return command;
+    }
+};
+
+/// The motor frames have the number of the motor
+template <>
+struct frame_command<HASHMAP_MOTOR>
+{
+    static unsigned char build(unsigned char index, unsigned char command)
+    {
+        motor_command_map_t map;
+        map.bitset.motor = index;
+        map.bitset.command = command;
+        return map.command_message;
+    }
+};
+
+/// The peripheral frames have the number of the port
+template <>
+struct frame_command<HASHMAP_PERIPHERALS>
+{
+    static unsigned char build(unsigned char index, unsigned char command)
+    {
+        peripheral_gpio_map_t map;
+        map.bitset.port = index;
+        map.bitset.command = command;
+        return map.message;
+    }
+};
+
+/**
+ * @brief encode Build a data frame with only the bytes of the payload
+ * @param index number of the motor or of the port, not used for the system frames
+ * @param payload the data to send
+ * @return the frame
+ */
+template <unsigned char Hashmap, unsigned char Command>
+inline packet_information_t encode(unsigned char index, const typename frame_descriptor<Hashmap, Command>::payload_t &payload)
+{
+    typedef frame_descriptor<Hashmap, Command> descriptor;
+    static_assert(descriptor::direction & FRAME_TX, "This frame cannot be sent to the board");
+    static_assert(descriptor::size <= sizeof(message_abstract_u), "Payload larger than the message");
+    packet_information_t frame;
+    frame.length = ORBUS_FRAME_HEADER + descriptor::size;
+    frame.option = PACKET_DATA;
+    frame.type = descriptor::hashmap;
+    frame.command = frame_command<Hashmap>::build(index, descriptor::command);
+    memcpy(&frame.message, &payload, descriptor::size);
+    return frame;
+}
+
+/**
+ * @brief request Build a frame to request data from the board
+ * @param index number of the motor or of the port, not used for the system frames
+ * @return the frame
+ */
+template <unsigned char Hashmap, unsigned char Command>
+inline packet_information_t request(unsigned char index = 0)
+{
+    typedef frame_descriptor<Hashmap, Command> descriptor;
+    static_assert(descriptor::direction & FRAME_RX, "This frame cannot be requested from the board");
+    return CREATE_PACKET_RESPONSE(frame_command<Hashmap>::build(index, descriptor::command), descriptor::hashmap, PACKET_REQUEST);
+}
+
+/**
+ * @brief decode Read the payload from a message received
+ * @param message the message
+ * @return the payload
+ */
+template <unsigned char Hashmap, unsigned char Command>
+inline const typename frame_descriptor<Hashmap, Command>::payload_t &decode(const message_abstract_u &message)
+{
+    typedef frame_descriptor<Hashmap, Command> descriptor;
+    static_assert(descriptor::direction & FRAME_RX, "This frame is never received from the board");
+    return *reinterpret_cast<const typename descriptor::payload_t*>(&message);
+}
+
+}
+
+#endif // FRAME_DESCRIPTOR_H
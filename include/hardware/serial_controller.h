@@ -9,6 +9,7 @@
 #include <or_bus/or_frame.h>
 
 #include <mutex>
+#include <atomic>
 
 using namespace std;
 
@@ -16,7 +17,7 @@ namespace orbus
 {
 
 /// Read complete callback - Array of callback
-typedef function<void (unsigned char option, unsigned char type, unsigned char command, message_abstract_u message) > callback_data_packet_t;
+typedef function<void (unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) > callback_data_packet_t;
 
 typedef enum serial_status
 {
@@ -29,6 +30,23 @@ typedef enum serial_status
 
 } serial_status_t;
 
+/// Answer of the board to a frame sent
+typedef enum frame_answer
+{
+    FRAME_MISSING,          ///< Not answered or not sent
+    FRAME_ACK,              ///< Data accepted from the board
+    FRAME_NACK,             ///< Frame refused from the board
+    FRAME_DATA              ///< Data requested received
+} frame_answer_t;
+
+/// Answer of the board to each frame of a transaction
+typedef struct _frame_result
+{
+    unsigned char type;     ///< Hashmap of the frame
+    unsigned char command;  ///< Full command of the frame
+    frame_answer_t answer;
+} frame_result_t;
+
 class serial_controller
 {
 public:
@@ -61,37 +79,128 @@ public:
     /**
      *
      */
-    template <class T> bool addCallback(void(T::*fp)(unsigned char, unsigned char, unsigned char, message_abstract_u), T* obj, unsigned char type) {
+    template <class T> bool addCallback(void(T::*fp)(unsigned char, unsigned char, unsigned char, const message_abstract_u&), T* obj, unsigned char type) {
         return addCallback(bind(fp, obj, _1, _2, _3, _4), type);
     }
 
-    serial_controller* addFrame(vector<packet_information_t> packet);
+    /**
+     * @brief addFrame Queue frames for the next transaction. Never waits
+     * the transaction in progress
+     * @param packet the frames
+     * @return the serial controller
+     */
+    serial_controller* addFrame(const vector<packet_information_t> &packet);
 
-    serial_controller *addFrame(packet_information_t packet);
+    serial_controller *addFrame(const packet_information_t &packet);
 
+    /**
+     * @brief sendList Send all frames in the list. On failure the frames
+     * already written are removed, the frames not written stay in the list
+     * @return true if the board answered to all packets
+     */
     bool sendList();
+    /**
+     * @brief sendList Send all frames in the list with the answer of each frame
+     * @param results answer of each frame, in the order of the list
+     * @return true if the board answered to all packets
+     */
+    bool sendList(vector<frame_result_t> &results);
+    /**
+     * @brief sendNow Send immediately a batch of frames, before all frames
+     * in the list, in one packet: the board applies all frames or none
+     * @param frames first frame to send
+     * @param size number of frames
+     * @param replies all frames received from the board, in order
+     * @return true if the board answered, false also if the batch does not fit in one packet
+     */
+    bool sendNow(const packet_information_t *frames, size_t size, vector<packet_information_t> &replies);
 
     void resetList();
 
     serial_status_t getStatus();
+    /**
+     * @brief getNack Number of frames refused from the board
+     * in the last transaction
+     * @return the number of NACK received
+     */
+    unsigned int getNack();
+    /**
+     * @brief getBaudrate
+     * @return the baudrate of the serial port
+     */
+    unsigned long getBaudrate();
+    /**
+     * @brief getTurnaround Time of the board to answer a packet, without
+     * the time on the wire. Averaged on all packets
+     * @return the turnaround in seconds, zero if not measured
+     */
+    double getTurnaround();
+    /**
+     * @brief getFailures Number of packets without answer from the start
+     * @return the number of failures
+     */
+    unsigned long getFailures();
+    /**
+     * @brief getCopied Bytes of the frames copied in the transport, from the
+     * encoded packet to the port and from the received packet to the callbacks
+     * @return the bytes copied from the start
+     */
+    unsigned long getCopied();
 
     bool isAlive();
+    /**
+     * @brief setEmergency Encode once the packet of the emergency stop
+     * @param frames all frames of the emergency stop
+     * @return true if all frames are in one packet
+     */
+    bool setEmergency(const vector<packet_information_t> &frames);
+    /**
+     * @brief emergency Write the emergency packet without waiting the transaction
+     * in progress. The packet is written between two packets and the reply
+     * is discarded before the next transaction. A reader waiting the reply
+     * of the transaction in progress is woken. From now the references and
+     * the states that drive a motor are dropped, until releaseEmergency().
+     * Thread safe.
+     * @return true if the packet is written
+     */
+    bool emergency();
+    /**
+     * @brief releaseEmergency Send again the references to the motors
+     */
+    void releaseEmergency();
+    /**
+     * @brief isLatched
+     * @return true if the references to the motors are dropped
+     */
+    bool isLatched() const { return mLatched; }
+    /**
+     * @brief dispatchMutex Lock held from all callbacks, from any thread.
+     * Hold it to use the state updated from the callbacks, the frames
+     * received from other threads wait until it is released.
+     * Recursive, a callback can send new frames.
+     * @return the lock of the callbacks
+     */
+    recursive_mutex &dispatchMutex() { return mDispatchMutex; }
 
 protected:
 
-    bool sendSerialFrame(packet_information_t frame);
+    bool sendSerialFrame(const packet_information_t &frame, vector<packet_information_t> &received);
     /**
-     * @brief sendSerialFrame
-     * @param list_send
-     * @return
+     * @brief sendSerialFrame Encode the frames in the transmission packet
+     * and send in the minimum number of packets
+     * @param list_send first frame to send
+     * @param size number of frames
+     * @param received all frames received from the board
+     * @param sent number of frames written on the port, also on failure
+     * @return true if the board answered to all packets
      */
-    bool sendSerialFrame(vector<packet_information_t> list_send);
+    bool sendSerialFrame(const packet_information_t *list_send, size_t size, vector<packet_information_t> &received, size_t &sent);
     /**
      * @brief sendSerialPacket
      * @param packet
-     * @return
+     * @return true if a reply is available in mReceive
      */
-    packet_t sendSerialPacket(packet_t packet);
+    bool sendSerialPacket(const packet_t &packet);
 
 private:
     /**
@@ -118,18 +227,62 @@ private:
      * @param packet the packet to send
      * @return if well written return true
      */
-    bool writePacket(packet_t packet);
+    bool writePacket(const packet_t &packet);
     /**
      * @brief readPacket
+     * @param cancel if true an emergency stop cancels the read
      * @return if received all data in packet return true
      */
-    bool readPacket();
+    bool readPacket(bool cancel);
+    /**
+     * @brief filterMotion Remove from a packet all frames not allowed
+     * while the emergency is latched, see allowedLatched
+     * @param packet the packet
+     * @param filtered the packet without these frames
+     * @return true if at least one frame is removed
+     */
+    static bool filterMotion(const packet_t &packet, packet_t &filtered);
     /**
-     * @brief parse_packet
+     * @brief allowedLatched Frames sent while the emergency is latched:
+     * requests, frames of the other hashmaps and the motor state set to
+     * disable or emergency. Any other motor data is dropped.
+     * @param frame the frame
+     * @return true if the frame can be sent
+     */
+    static bool allowedLatched(const packet_information_t &frame);
+    /**
+     * @brief transaction Send the list and dispatch the frames received
+     * @param results answer of each frame, NULL if not required
+     * @return true if the board answered to all packets
+     */
+    bool transaction(vector<frame_result_t> *results);
+    /**
+     * @brief matchReplies Answer of each frame, the replies are in the order of the frames
+     * @param frames first frame sent
+     * @param size number of frames
+     * @param received all frames received
+     * @param results answer of each frame
+     */
+    static void matchReplies(const packet_information_t *frames, size_t size, const vector<packet_information_t> &received, vector<frame_result_t> &results);
+    /**
+     * @brief parse_packet Decode all frames in the packet. The callbacks
+     * are not called here, the transport is still locked. mReceive is
+     * reused from the next transaction, the bytes of each frame are
+     * copied once in an aligned slot owned from the caller
      * @param receive
+     * @param received where are appended all frames
      * @return
      */
-    bool parse_packet(packet_t receive);
+    bool parse_packet(const packet_t &receive, vector<packet_information_t> &received);
+    /**
+     * @brief dispatch Run the callbacks for all frames received.
+     * Called after the transport lock is released, a callback can
+     * add new frames with addFrame(). The callbacks of different
+     * threads are serialized with dispatchMutex(). The callbacks
+     * read the message in place from the slots
+     * @param received all frames received
+     */
+    void dispatch(const vector<packet_information_t> &received);
 
 private:
     // Serial port object
@@ -140,24 +293,64 @@ private:
     uint32_t mBaudrate;
     // Timeout open serial port
     uint32_t mTimeout;
+    // The reply is waited in slices, an emergency stop wakes the reader
+    uint32_t mReadSlice;
     // Used to stop the serial processing
     bool mStopping;
     // Status of the serial communication
     serial_status_t mStatus;
+    // Number of NACK received in the last transaction
+    unsigned int mNack;
+    // Average turnaround of the board, written in the transaction and read from the diagnostic
+    atomic<double> mTurnaround;
+    // Packets without answer, written in the transaction and read from the diagnostic
+    atomic<unsigned long> mFailures;
+    // Bytes of the frames copied, written in the transaction
+    atomic<unsigned long> mCopied;
 
     // The packet received from serial
     packet_t mReceive;
+    // The packet to send, reused for each transaction
+    packet_t mTransmit;
     // buffer to send in Tx transimssion
     unsigned char BufferTx[MAX_BUFF_TX];
+    // buffer to read from the serial port, bytes after a packet are kept for the next one
+    uint8_t BufferRx[MAX_BUFF_TX];
+    size_t mRxHead, mRxSize;
+    // Emergency packet, already built
+    unsigned char BufferEmergency[MAX_BUFF_TX];
+    size_t mEmergencySize;
+    // Number of emergency replies to discard
+    atomic<unsigned int> mEmergencyPending;
+    // Emergency stop latched, the motion frames are dropped
+    atomic<bool> mLatched;
+    // Emergency written while a reply is waited
+    atomic<bool> mCancel;
+    // The last transaction is cancelled from the emergency
+    bool mCancelled;
+    // The last packet is not written, all frames are dropped
+    bool mDropped;
+    // The last packet is written or dropped, its frames are not sent again
+    bool mWritten;
+    // Packet without the motion frames
+    packet_t mFiltered;
 
     // Hashmap with all type of message
     map<int, callback_data_packet_t> hashmap;
 
     // List of all frame to send
     vector<packet_information_t> list_send;
+    // Frames queued from any thread, moved in the list at the start of each transaction
+    vector<packet_information_t> list_queued;
 
     // Mutex to sto concurent sending
     mutex mMutex;
+    // Mutex of the write on the port, a packet is never split
+    mutex mWriteMutex;
+    // Mutex of the callbacks, never taken with mMutex locked
+    recursive_mutex mDispatchMutex;
+    // Mutex of the queued frames, held only to copy the frames
+    mutex mQueueMutex;
 };
 
 }
@@ -2,32 +2,34 @@
 #define UNAVCONTROLLER_H
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 
 #include <hardware_interface/robot_hw.h>
 
 #include <urdf/model.h>
 
+#include <orbus_interface/ControlRate.h>
+#include <orbus_interface/JointTelemetry.h>
+#include <std_msgs/Bool.h>
+#include <std_srvs/Empty.h>
+
+#include <atomic>
+
 #include "hardware/Motor.h"
 #include "hardware/GenericInterface.h"
+#include "hardware/LinkBudget.h"
+#include "hardware/AdaptiveRate.h"
 
 namespace ORInterface
 {
 
-typedef struct joint
-{
-    Motor *motor;
-    // State of the motor
-    double position;
-    double velocity;
-    double effort;
-    double velocity_command;
-} joint_t;
-
 class uNavInterface : public GenericInterface, public hardware_interface::RobotHW
 {
 public:
     uNavInterface(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh, orbus::serial_controller *serial);
 
+    ~uNavInterface();
+
     bool prepareSwitch(const std::list<hardware_interface::ControllerInfo>& start_list, const std::list<hardware_interface::ControllerInfo>& stop_list);
 
     void doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list, const std::list<hardware_interface::ControllerInfo>& stop_list);
@@ -39,8 +41,9 @@ public:
     /**
      * @brief initializeInterfaces Initialize all motors.
      * Add all Control Interface availbles and add in diagnostic task
+     * @param model URDF of the robot, the limits are loaded from here
      */
-    void initializeInterfaces();
+    void initializeInterfaces(const urdf::Model &model);
     /**
      * @brief updateDiagnostics
      */
@@ -51,9 +54,60 @@ public:
      */
     void initialize();
 
+    /**
+     * @brief emergencyStop Stop all motors now, without waiting the control loop.
+     * The motors are disabled on the host until the controllers are restarted,
+     * the serial controller drops the references until releaseEmergency()
+     * @return true if the stop is written on the serial port
+     */
+    bool emergencyStop();
+    /**
+     * @brief releaseEmergency Allow again to start the controllers
+     */
+    void releaseEmergency();
+    /**
+     * @brief planLink Plan the serial link with the streams scheduled now
+     * @return false if the link is overloaded and the node must refuse to start
+     */
+    bool planLink();
+
+    void run(diagnostic_updater::DiagnosticStatusWrapper &stat);
+    /**
+     * @brief updateRate Adapt the rates to the link, call after updateDiagnostics
+     * @param connected status of the link from the diagnostic
+     * @return true if the frequency of the control loop is changed
+     */
+    bool updateRate(bool connected);
+    /**
+     * @brief adaptiveRate
+     * @return true if the rates follow the status of the link
+     */
+    bool adaptiveRate() const { return mRate.enabled(); }
+    /**
+     * @brief controlFrequency
+     * @return the effective frequency of the control loop
+     */
+    double controlFrequency() const { return mRate.frequency(); }
+    /**
+     * @brief linkLost
+     * @return true if the diagnostic has lost the board, the control loop must wait
+     */
+    bool linkLost() const { return mLinkLost; }
+
 private:
 
-    void allMotorsFrame(unsigned char option, unsigned char type, unsigned char command, message_abstract_u message);
+    void allMotorsFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message);
+    /**
+     * @brief updateIdle Slow down the measures when all motors are disabled,
+     * full rate from the next cycle when a motor is driven
+     */
+    void updateIdle();
+    /**
+     * @brief limitRate Keep two commands in the emergency timeout of each motor
+     * at the minimum rate of the control loop
+     * @return true if the minimum rate is changed
+     */
+    bool limitRate();
 
     /**
     * @brief service_Callback
@@ -63,19 +117,79 @@ private:
     */
     bool service_Callback(orbus_interface::Service::Request &req, orbus_interface::Service::Response &msg);
 
-private:
-    /// URDF information about robot
-    urdf::Model model;
+    bool emergency_Callback(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+
+    void emergency_subscriber_Callback(const std_msgs::Bool::ConstPtr& msg);
 
+private:
     /// ROS Control interfaces
     hardware_interface::JointStateInterface joint_state_interface;
     hardware_interface::VelocityJointInterface velocity_joint_interface;
 
-    map<string, Motor*> mMotor;
-    map<int, string> mMotorName;
+    /// Hot state of all joints
+    joint_table_t mTable;
+    /// Motors indexed by number, NULL if not used
+    Motor *mMotor[MAX_MOTORS];
+    /// Numbers of all motors used, in order of configuration
+    vector<unsigned int> mJoints;
+    /// Number of the motor from the name, only for configuration
+    map<string, unsigned int> mMotorNumber;
+
+    /// Cache of the configuration acknowledged from the board
+    ConfigCache *mCache;
+    /// Snapshot of the parameter server, loaded only on initialization
+    ParamSnapshot *mSnapshot;
+    /// Worker of the updates of the parameter server from the board
+    ParamWriter *mWriter;
+
+    /// Frames of the switch of the controllers and replies from the board
+    vector<packet_information_t> mSwitchFrames, mSwitchReplies;
+    /// Latency of the switch, maximum measured and limit before a warning
+    double mSwitchLatencyMax, mSwitchLatencyLimit;
+
+    /// Emergency stop active, set from any thread
+    std::atomic<bool> mEmergency;
+    /// Maximum latency to write the emergency stop, from the emergency thread and the control loop
+    std::atomic<double> mEmergencyLatencyMax;
+
+    /// Budget of the serial link
+    LinkBudget mLinkBudget;
+    /// Telemetry and GPIO frames in the last plan, planned again on a new subscription
+    size_t mLinkTelemetry, mLinkGpio;
+
+    /// Rate of the control loop on a degraded link
+    AdaptiveRate mRate;
+    /// Time of the transactions of the last cycle and maximum from the last diagnostic
+    double mCycleLatency, mCycleLatencyMax;
+    /// End of the last read and time to the write of the commands
+    ros::WallTime mReadEnd;
+    double mUpdateDelay;
+    /// Failures of the link at the last diagnostic
+    unsigned long mFailures;
+    bool mLinkLost;
+    /// The configuration is sent at least once, a new initialization follows a link loss
+    bool mSynced;
+
+    /// Measures of all joints in one message, published once per cycle
+    bool mAggregate;
+    ros::Publisher pub_telemetry;
+    TopicGate gate_telemetry;
+    orbus_interface::JointTelemetry msg_telemetry;
+
+    /// Divisor of the measures without controllers running
+    unsigned int mIdleDivisor;
+    bool mIdle;
+    // Rate changes
+    ros::Publisher pub_rate;
+    orbus_interface::ControlRate msg_rate;
 
     // Service board
     ros::ServiceServer srv_unav;
+    // Emergency stop, served from its own queue and thread
+    ros::CallbackQueue mEmergencyQueue;
+    ros::AsyncSpinner mEmergencySpinner;
+    ros::ServiceServer srv_emergency;
+    ros::Subscriber sub_emergency;
 };
 
 }
@@ -0,0 +1,188 @@
+#include "configurator/ConfigCache.h"
+
+#include <fstream>
+
+using namespace std;
+
+// Header of the binary file
+#define CACHE_MAGIC 0x4342524F
+#define CACHE_VERSION 2
+
+ConfigCache::ConfigCache(string path, string board)
+    : mPath(path)
+    , mBoard(board)
+    , mDirty(false)
+{
+}
+
+uint64_t ConfigCache::hash(const void *data, size_t size)
+{
+    // FNV-1a 64 bit
+    const unsigned char *buffer = (const unsigned char*) data;
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < size; ++i)
+    {
+        value ^= buffer[i];
+        value *= 0x100000001b3ULL;
+    }
+    return value;
+}
+
+bool ConfigCache::load()
+{
+    lock_guard<mutex> lock(mMutex);
+    ifstream file(mPath.c_str(), ios::in | ios::binary);
+    if(!file.is_open())
+    {
+        ROS_INFO_STREAM("No configuration cache in " << mPath);
+        return false;
+    }
+    uint32_t magic = 0, version = 0, length = 0, size = 0;
+    file.read((char*) &magic, sizeof(magic));
+    file.read((char*) &version, sizeof(version));
+    file.read((char*) &length, sizeof(length));
+    if(!file || magic != CACHE_MAGIC || version != CACHE_VERSION || length > 256)
+    {
+        ROS_WARN_STREAM("Configuration cache " << mPath << " not valid");
+        return false;
+    }
+    string board(length, '\0');
+    file.read(&board[0], length);
+    if(board.compare(mBoard) != 0)
+    {
+        ROS_WARN_STREAM("Configuration cache " << mPath << " is for " << board << " and not for " << mBoard);
+        return false;
+    }
+    file.read((char*) &size, sizeof(size));
+    mAck.clear();
+    for(uint32_t i = 0; i < size && file; ++i)
+    {
+        uint32_t key;
+        uint64_t value;
+        file.read((char*) &key, sizeof(key));
+        file.read((char*) &value, sizeof(value));
+        if(file)
+        {
+            mAck[key] = value;
+        }
+    }
+    ROS_INFO_STREAM("Load " << mAck.size() << " configurations from cache " << mPath);
+    return true;
+}
+
+bool ConfigCache::save()
+{
+    lock_guard<mutex> lock(mMutex);
+    return saveLocked();
+}
+
+bool ConfigCache::saveLocked()
+{
+    ofstream file(mPath.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!file.is_open())
+    {
+        ROS_ERROR_STREAM("Unable to write configuration cache " << mPath);
+        return false;
+    }
+    uint32_t magic = CACHE_MAGIC, version = CACHE_VERSION;
+    uint32_t length = mBoard.size(), size = mAck.size();
+    file.write((const char*) &magic, sizeof(magic));
+    file.write((const char*) &version, sizeof(version));
+    file.write((const char*) &length, sizeof(length));
+    file.write(mBoard.data(), length);
+    file.write((const char*) &size, sizeof(size));
+    for(map<unsigned int, uint64_t>::iterator it = mAck.begin(); it != mAck.end(); ++it)
+    {
+        uint32_t key = it->first;
+        uint64_t value = it->second;
+        file.write((const char*) &key, sizeof(key));
+        file.write((const char*) &value, sizeof(value));
+    }
+    mDirty = !file.good();
+    return file.good();
+}
+
+bool ConfigCache::isSynced(unsigned int key, const void *data, size_t size)
+{
+    lock_guard<mutex> lock(mMutex);
+    uint64_t value = hash(data, size);
+    map<unsigned int, uint64_t>::iterator it = mAck.find(key);
+    if(it != mAck.end() && it->second == value)
+    {
+        return true;
+    }
+    mPending[key] = value;
+    return false;
+}
+
+void ConfigCache::commit()
+{
+    lock_guard<mutex> lock(mMutex);
+    if(mPending.empty())
+    {
+        return;
+    }
+    for(map<unsigned int, uint64_t>::iterator it = mPending.begin(); it != mPending.end(); ++it)
+    {
+        mAck[it->first] = it->second;
+    }
+    mPending.clear();
+    saveLocked();
+}
+
+void ConfigCache::discard()
+{
+    lock_guard<mutex> lock(mMutex);
+    // The board state is unknown, on the next sync send everything
+    for(map<unsigned int, uint64_t>::iterator it = mPending.begin(); it != mPending.end(); ++it)
+    {
+        mAck.erase(it->first);
+    }
+    mPending.clear();
+}
+
+void ConfigCache::invalidate(unsigned int key)
+{
+    lock_guard<mutex> lock(mMutex);
+    mPending.erase(key);
+    // Stored immediately, the node can be stopped before the next sync
+    if(mAck.erase(key) > 0)
+    {
+        saveLocked();
+    }
+}
+
+void ConfigCache::clear()
+{
+    lock_guard<mutex> lock(mMutex);
+    mPending.clear();
+    if(!mAck.empty())
+    {
+        mAck.clear();
+        saveLocked();
+    }
+}
+
+void ConfigCache::update(unsigned int key, const void *data, size_t size)
+{
+    lock_guard<mutex> lock(mMutex);
+    uint64_t value = hash(data, size);
+    mPending.erase(key);
+    map<unsigned int, uint64_t>::iterator it = mAck.find(key);
+    if(it == mAck.end() || it->second != value)
+    {
+        // Called from the dispatch path, the file is written from flush()
+        mAck[key] = value;
+        mDirty = true;
+    }
+}
+
+bool ConfigCache::flush()
+{
+    lock_guard<mutex> lock(mMutex);
+    if(!mDirty)
+    {
+        return true;
+    }
+    return saveLocked();
+}
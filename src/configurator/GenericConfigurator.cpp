@@ -1,7 +1,12 @@
 #include "configurator/GenericConfigurator.h"
+#include "hardware/allocation_check.h"
 
 using namespace std;
 
+ConfigCache *GenericConfigurator::mCache = NULL;
+ParamSnapshot *GenericConfigurator::mSnapshot = NULL;
+ParamWriter *GenericConfigurator::mWriter = NULL;
+
 GenericConfigurator::GenericConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, unsigned int number)
     : nh_(nh)
     , mSerial(serial)
@@ -10,14 +15,78 @@ GenericConfigurator::GenericConfigurator(const ros::NodeHandle &nh, orbus::seria
     mCommand.bitset.motor = number;
     // Set false on first run
     setup_ = false;
+    sent_ = false;
+    waiting_ = false;
+    pending_size_ = 0;
+    queued_size_ = 0;
+    // Dynamic reconfigure servers started on request
+    nh_.param<bool>("lazy_reconfigure", lazy_, false);
+    // Window to merge all changes from dynamic reconfigure
+    nh_.param<double>("reconfigure_debounce", debounce_, 0.1);
+    debounce_timer_ = nh_.createTimer(ros::Duration(debounce_), &GenericConfigurator::debounceCB, this, true, false);
+}
+
+void GenericConfigurator::setCache(ConfigCache *cache)
+{
+    mCache = cache;
+}
+
+void GenericConfigurator::setSnapshot(ParamSnapshot *snapshot)
+{
+    mSnapshot = snapshot;
+}
+
+void GenericConfigurator::setWriter(ParamWriter *writer)
+{
+    mWriter = writer;
+}
+
+ParamSnapshot::Key GenericConfigurator::paramKey(const string &name) const
+{
+    string full = mName + name;
+    if(mSnapshot != NULL)
+    {
+        return mSnapshot->key(full);
+    }
+    ParamSnapshot::Key key;
+    key.name = full;
+    return key;
+}
+
+bool GenericConfigurator::isSynced(const void *data, size_t size)
+{
+    if(mCache != NULL && mCache->isSynced(mCommand.command_message, data, size))
+    {
+        ROS_DEBUG_STREAM("PARAM:" << mName << " already in uNav");
+        return true;
+    }
+    return false;
+}
+
+void GenericConfigurator::postParam(const message_abstract_u &message)
+{
+    if(mWriter == NULL)
+    {
+        ROS_WARN_STREAM("PARAM:" << mName << " update dropped, no writer");
+    }
+    else if(!mWriter->post(this, message))
+    {
+        ROS_WARN_STREAM("PARAM:" << mName << " update dropped, queue full");
+    }
 }
 
-void GenericConfigurator::SendParameterToBoard(message_abstract_u message)
+void GenericConfigurator::SendParameterToBoard(message_abstract_u message, bool send)
 {
     packet_information_t frame = CREATE_PACKET_DATA(mCommand.command_message, HASHMAP_MOTOR, message);
-    // Add packet in the frame and send
-//    mSerial->addFrame(frame);
-    if(mSerial->addFrame(frame)->sendList())
+    // Add packet in the frame
+    mSerial->addFrame(frame);
+    if(!send)
+    {
+        ROS_DEBUG_STREAM("Queued PARAM:" << mName);
+        return;
+    }
+    // Send the list
+    if(mSerial->sendList())
     {
         ROS_DEBUG_STREAM("Write PARAM:" << mName << " in uNav");
     }
@@ -26,3 +95,67 @@ void GenericConfigurator::SendParameterToBoard(message_abstract_u message)
         ROS_ERROR_STREAM("Unable to receive packet from uNav");
     }
 }
+
+void GenericConfigurator::UpdateParameterToBoard(message_abstract_u message, size_t size)
+{
+    {
+        lock_guard<mutex> lock(param_mutex_);
+        pending_ = message;
+        pending_size_ = size;
+    }
+    // Restart the debounce window
+    debounce_timer_.stop();
+    debounce_timer_.setPeriod(ros::Duration(debounce_));
+    debounce_timer_.start();
+}
+
+void GenericConfigurator::debounceCB(const ros::TimerEvent& event)
+{
+    message_abstract_u message;
+    {
+        lock_guard<mutex> lock(param_mutex_);
+        // Skip if the board has already this configuration
+        if(sent_ && memcmp(&pending_, &last_sent_, pending_size_) == 0)
+        {
+            ROS_DEBUG_STREAM("PARAM:" << mName << " not changed");
+            return;
+        }
+        // Stored as last sent only from the answer of the board
+        queued_ = pending_;
+        queued_size_ = pending_size_;
+        waiting_ = true;
+        message = pending_;
+    }
+    // The board state is not known until the answer
+    if(mCache != NULL)
+    {
+        mCache->invalidate(mCommand.command_message);
+    }
+    // Queue the frame, it is sent with the next transaction
+    SendParameterToBoard(message, false);
+}
+
+void GenericConfigurator::answer(unsigned char option)
+{
+    lock_guard<mutex> lock(param_mutex_);
+    // Only the answer of a debounced configuration
+    if(!waiting_)
+    {
+        return;
+    }
+    waiting_ = false;
+    // The log and the first insert in the cache are not checked
+    orbus::allocation::pause unchecked;
+    if(option != PACKET_ACK)
+    {
+        ROS_ERROR_STREAM("PARAM:" << mName << " refused from uNav");
+        return;
+    }
+    ROS_DEBUG_STREAM("Write PARAM:" << mName << " in uNav");
+    last_sent_ = queued_;
+    sent_ = true;
+    if(mCache != NULL)
+    {
+        mCache->update(mCommand.command_message, &queued_, queued_size_);
+    }
+}
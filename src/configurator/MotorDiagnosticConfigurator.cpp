@@ -3,61 +3,50 @@
 using namespace std;
 
 MotorDiagnosticConfigurator::MotorDiagnosticConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, string path, string name, unsigned int type, unsigned int number)
- : GenericConfigurator(nh, serial, number)
+ : SafetyConfigurator(nh, serial, number)
 {
     // Find path param
     mName = nh_.getNamespace() + "/" + path + "/diagnostic/" + name;
     // Set command type
     mCommand.bitset.command = type;
+    // Keys of all parameters
+    initKeys();
 
     //Load dynamic reconfigure
-    dsrv_ = new dynamic_reconfigure::Server<orbus_interface::UnavDiagnosticConfig>(ros::NodeHandle(mName));
-    dynamic_reconfigure::Server<orbus_interface::UnavDiagnosticConfig>::CallbackType cb = boost::bind(&MotorDiagnosticConfigurator::reconfigureCB, this, _1, _2);
-    dsrv_->setCallback(cb);
+    dsrv_ = NULL;
+    loadServer(dsrv_, mName, &MotorDiagnosticConfigurator::reconfigureCB, this, !lazy_);
 }
 
-void MotorDiagnosticConfigurator::initConfigurator()
+MotorDiagnosticConfigurator::~MotorDiagnosticConfigurator()
 {
-    if(mCommand.bitset.command != 0xFFFF)
-    {
-        /// Send configuration to board
-        message_abstract_u temp;
-        temp.motor.safety = getParam();
-        /// Call the function in Generic Reconfigurator
-        SendParameterToBoard(temp);
-    }
+    delete dsrv_;
 }
 
-motor_safety_t MotorDiagnosticConfigurator::getParam()
+void MotorDiagnosticConfigurator::initReconfigure()
 {
-    motor_safety_t safety;
-
-    double temp_double;
-    int temp_int;
-    bool temp;
-
-    nh_.getParam(mName + "/critical", temp_double);
-    safety.critical_zone = (motor_control_t) (temp_double*1000.0);
-    nh_.getParam(mName + "/timeout", temp_int);
-    safety.timeout = (uint32_t) temp_int;
-    nh_.getParam(mName + "/autorestore", temp_int);
-    safety.autorestore = (uint32_t) temp_int;
-
-    ROS_DEBUG_STREAM("Read safety from " << mName << " [critical:" << safety.critical_zone << ", Timeout:" << (int) safety.timeout << ", Autorestore:" << (int) safety.autorestore << "]");
-
-    return safety;
+    loadServer(dsrv_, mName, &MotorDiagnosticConfigurator::reconfigureCB, this, true);
 }
 
+void MotorDiagnosticConfigurator::initConfigurator()
+{
+    if(mCommand.bitset.command != 0xFFFF)
+    {
+        SafetyConfigurator::initConfigurator();
+    }
+}
 
 void MotorDiagnosticConfigurator::reconfigureCB(orbus_interface::UnavDiagnosticConfig &config, uint32_t level)
 {
     motor_safety_t safety;
+    // Clean all padding, the struct is compared with the last sent
+    memset(&safety, 0, sizeof(safety));
 
     levels.critical = config.critical;
     levels.warning = config.warning;
-    safety.critical_zone = (motor_control_t) (config.critical*1000.0);
-    safety.timeout = (uint32_t) config.timeout;
-    safety.autorestore = (uint32_t) config.autorestore;
+    // Same conversions of the parameter server
+    SafetyFieldCritical::set(safety, config.critical);
+    SafetyFieldTimeout::set(safety, config.timeout);
+    SafetyFieldAutorestore::set(safety, config.autorestore);
 
     //The first time we're called, we just want to make sure we have the
     //original configuration
@@ -78,10 +67,7 @@ void MotorDiagnosticConfigurator::reconfigureCB(orbus_interface::UnavDiagnosticC
     if(mCommand.bitset.command != 0xFFFF)
     {
         /// Send configuration to board
-        message_abstract_u temp;
-        temp.motor.safety = safety;
-        /// Call the function in Generic Reconfigurator
-        SendParameterToBoard(temp);
+        updateParam(safety);
     }
 
     last_config_ = config;
@@ -34,57 +34,46 @@
 using namespace std;
 
 MotorEmergencyConfigurator::MotorEmergencyConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, std::string name, unsigned int number)
-    : GenericConfigurator(nh, serial, number)
+    : EmergencyConfigurator(nh, serial, number)
+    , timeout_(100)
 {
     // Find path param
     mName = nh_.getNamespace() + "/" + name + "/emergency";
     // Set command message
     mCommand.bitset.command = MOTOR_EMERGENCY;
+    // Keys of all parameters
+    initKeys();
 
     //Load dynamic reconfigure
-    dsrv_ = new dynamic_reconfigure::Server<orbus_interface::UnavEmergencyConfig>(ros::NodeHandle(mName));
-    dynamic_reconfigure::Server<orbus_interface::UnavEmergencyConfig>::CallbackType cb = boost::bind(&MotorEmergencyConfigurator::reconfigureCB, this, _1, _2);
-    dsrv_->setCallback(cb);
+    dsrv_ = NULL;
+    loadServer(dsrv_, mName, &MotorEmergencyConfigurator::reconfigureCB, this, !lazy_);
 }
 
-void MotorEmergencyConfigurator::initConfigurator()
+MotorEmergencyConfigurator::~MotorEmergencyConfigurator()
 {
-    /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.emergency= getParam();
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
+    delete dsrv_;
 }
 
-void MotorEmergencyConfigurator::setParam(motor_emergency_t emergency) {
-    nh_.setParam(mName + "/Slope_time", emergency.slope_time);
-    nh_.setParam(mName + "/Bridge_off", emergency.bridge_off);
-    nh_.setParam(mName + "/Timeout", emergency.timeout);
+void MotorEmergencyConfigurator::initReconfigure()
+{
+    loadServer(dsrv_, mName, &MotorEmergencyConfigurator::reconfigureCB, this, true);
 }
 
-motor_emergency_t MotorEmergencyConfigurator::getParam() {
-    motor_emergency_t emergency;
-    int temp_int;
-    double temp_double;
-
-    nh_.getParam(mName + "/Slope_time", temp_double);
-    emergency.slope_time = (float) temp_double;
-
-    nh_.getParam(mName + "/Bridge_off", temp_double);
-    emergency.bridge_off = (float) temp_double;
-
-    nh_.getParam(mName + "/Timeout", temp_int);
-    emergency.timeout = (uint16_t) temp_int;
-
-    return emergency;
+void MotorEmergencyConfigurator::initConfigurator()
+{
+    timeout_ = EmergencyFieldTimeout::get(getParam());
+    EmergencyConfigurator::initConfigurator();
 }
 
 void MotorEmergencyConfigurator::reconfigureCB(orbus_interface::UnavEmergencyConfig &config, uint32_t level) {
 
     motor_emergency_t emergency;
-    emergency.bridge_off = (float) config.Bridge_off;
-    emergency.slope_time = (float) config.Slope_time;
-    emergency.timeout = (uint16_t) config.Timeout;
+    // Clean all padding, the struct is compared with the last sent
+    memset(&emergency, 0, sizeof(emergency));
+    // Same conversions of the parameter server
+    EmergencyFieldBridgeOff::set(emergency, config.Bridge_off);
+    EmergencyFieldSlopeTime::set(emergency, config.Slope_time);
+    EmergencyFieldTimeout::set(emergency, config.Timeout);
 
     //The first time we're called, we just want to make sure we have the
     //original configuration
@@ -103,11 +92,9 @@ void MotorEmergencyConfigurator::reconfigureCB(orbus_interface::UnavEmergencyCon
     }
 
     /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.emergency = emergency;
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
+    updateParam(emergency);
 
     // Store last emergency data
     last_emergency_ = emergency;
+    timeout_ = EmergencyFieldTimeout::get(emergency);
 }
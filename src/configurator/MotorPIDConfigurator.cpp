@@ -34,7 +34,7 @@
 using namespace std;
 
 MotorPIDConfigurator::MotorPIDConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, string path, string name, unsigned int type, unsigned int number)
-    : GenericConfigurator(nh, serial, number)
+    : PIDConfigurator(nh, serial, number)
 {
     // Find path param
     mName = nh_.getNamespace() + "/" + path + "/pid/" + name;
@@ -43,77 +43,36 @@ MotorPIDConfigurator::MotorPIDConfigurator(const ros::NodeHandle &nh, orbus::ser
     // Set command message
 //    mCommand.bitset.motor = number;
     mCommand.bitset.command = type;
+    // Keys of all parameters
+    initKeys();
 
     //Load dynamic reconfigure
-    dsrv_ = new dynamic_reconfigure::Server<orbus_interface::UnavPIDConfig>(ros::NodeHandle(mName));
-    dynamic_reconfigure::Server<orbus_interface::UnavPIDConfig>::CallbackType cb = boost::bind(&MotorPIDConfigurator::reconfigureCB, this, _1, _2);
-    dsrv_->setCallback(cb);
+    dsrv_ = NULL;
+    loadServer(dsrv_, mName, &MotorPIDConfigurator::reconfigureCB, this, !lazy_);
 }
 
-void MotorPIDConfigurator::initConfigurator()
+MotorPIDConfigurator::~MotorPIDConfigurator()
 {
-    /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.pid = getParam();
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
-
-//    else {
-//        ROS_WARN_STREAM("Any PID paramerter for: " << key << " . Send request to uNav");
-//        // Build a packet
-//        packet_information_t frame = CREATE_PACKET_RESPONSE(mCommand.command_message, HASHMAP_MOTOR, PACKET_REQUEST);
-//        // Add packet in the frame
-//        if(mSerial->addFrame(frame)->sendList())
-//        {
-//            ROS_WARN_STREAM("Write PARAM from uNav");
-//        }
-//    }
+    delete dsrv_;
 }
 
-void MotorPIDConfigurator::setParam(motor_pid_t pid) {
-    bool enable = (pid.enable > 0 ? true : false);
-    ROS_DEBUG_STREAM("Parameter [Kp:" << pid.kp << ", Ki:" << pid.ki << ", Kd:" << pid.kd << ", Kaw:" << pid.kaw << ", Freq:" << pid.frequency << "Hz, En:" << enable << "]");
-    nh_.setParam(mName + "/Kp", ((double) pid.kp));
-    nh_.setParam(mName + "/Ki", (double) pid.ki);
-    nh_.setParam(mName + "/Kd", (double) pid.kd);
-    nh_.setParam(mName + "/Kaw", (double) pid.kaw);
-    nh_.setParam(mName + "/Frequency", (int) pid.frequency);
-    nh_.setParam(mName + "/Enable", enable);
-}
-
-motor_pid_t MotorPIDConfigurator::getParam() {
-    motor_pid_t pid;
-
-    double temp_double;
-    int temp_int;
-    bool temp;
-
-    nh_.getParam(mName + "/Kp", temp_double);
-    pid.kp = static_cast<float>(temp_double);
-    nh_.getParam(mName + "/Ki", temp_double);
-    pid.ki = static_cast<float>(temp_double);
-    nh_.getParam(mName + "/Kd", temp_double);
-    pid.kd = static_cast<float>(temp_double);
-    nh_.getParam(mName + "/Kaw", temp_double);
-    pid.kaw = static_cast<float>(temp_double);
-    nh_.getParam(mName + "/Frequency", temp_int);
-    pid.frequency = static_cast<uint32_t>(temp_int);
-    nh_.getParam(mName + "/Enable", temp);
-    pid.enable = (temp == true ? 1 : 0);
-
-    ROS_DEBUG_STREAM("Read param from "<< mName << " [Kp:" << pid.kp << ", Ki:" << pid.ki << ", Kd:" << pid.kd << ", Kaw:" << pid.kaw << ", Freq:" << pid.frequency << "Hz, En:" << (int) pid.enable << "]");
-    return pid;
+void MotorPIDConfigurator::initReconfigure()
+{
+    loadServer(dsrv_, mName, &MotorPIDConfigurator::reconfigureCB, this, true);
 }
 
 void MotorPIDConfigurator::reconfigureCB(orbus_interface::UnavPIDConfig &config, uint32_t level) {
 
     motor_pid_t pid;
-    pid.kp = (float) config.Kp;
-    pid.ki = (float) config.Ki;
-    pid.kd = (float) config.Kd;
-    pid.kaw = (float) config.Kaw;
-    pid.frequency = (uint32_t) config.Frequency;
-    pid.enable = (config.Enable == true ? 1 : 0);
+    // Clean all padding, the struct is compared with the last sent
+    memset(&pid, 0, sizeof(pid));
+    // Same conversions of the parameter server
+    PIDFieldKp::set(pid, config.Kp);
+    PIDFieldKi::set(pid, config.Ki);
+    PIDFieldKd::set(pid, config.Kd);
+    PIDFieldKaw::set(pid, config.Kaw);
+    PIDFieldFrequency::set(pid, config.Frequency);
+    PIDFieldEnable::set(pid, config.Enable);
 
     //The first time we're called, we just want to make sure we have the
     //original configuration
@@ -138,10 +97,7 @@ void MotorPIDConfigurator::reconfigureCB(orbus_interface::UnavPIDConfig &config,
     ROS_DEBUG_STREAM("Send new param from "<< mName << " [Kp:" << pid.kp << ", Ki:" << pid.ki << ", Kd:" << pid.kd << ", Kaw:" << pid.kaw << ", Freq:" << pid.frequency << "Hz, En:" << (int) pid.enable << "]");
 
     /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.pid = pid;
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
+    updateParam(pid);
 
     // Store last value of PID
     last_pid_ = pid;
@@ -37,114 +37,49 @@ using namespace std;
 #define PARAM_ENCODER_STRING "/encoder"
 
 MotorParamConfigurator::MotorParamConfigurator(const ros::NodeHandle &nh, orbus::serial_controller *serial, std::string name, unsigned int number)
-    : GenericConfigurator(nh, serial, number)
+    : ParamConfigurator(nh, serial, number)
 {
     // Find path param
     mName = nh_.getNamespace() + "/" + name;
     // Set command message
     mCommand.bitset.command = MOTOR_PARAMETER;
+    // Keys of all parameters
+    initKeys();
 
     setup_param = false;
     setup_encoder = false;
     setup_bridge = false;
+    // Clean all padding, the struct is compared with the last sent
+    memset(&parameter, 0, sizeof(parameter));
 
     //Load dynamic reconfigure
-    ds_param = new dynamic_reconfigure::Server<orbus_interface::UnavParameterConfig>(ros::NodeHandle(mName));
-    dynamic_reconfigure::Server<orbus_interface::UnavParameterConfig>::CallbackType cb_param = boost::bind(&MotorParamConfigurator::reconfigureCBParam, this, _1, _2);
-    ds_param->setCallback(cb_param);
-
-    ds_encoder = new dynamic_reconfigure::Server<orbus_interface::UnavEncoderConfig>(ros::NodeHandle(mName + PARAM_ENCODER_STRING));
-    dynamic_reconfigure::Server<orbus_interface::UnavEncoderConfig>::CallbackType cb_encoder = boost::bind(&MotorParamConfigurator::reconfigureCBEncoder, this, _1, _2);
-    ds_encoder->setCallback(cb_encoder);
-
-    ds_bridge = new dynamic_reconfigure::Server<orbus_interface::UnavBridgeConfig>(ros::NodeHandle(mName + PARAM_BRIDGE_STRING));
-    dynamic_reconfigure::Server<orbus_interface::UnavBridgeConfig>::CallbackType cb_bridge = boost::bind(&MotorParamConfigurator::reconfigureCBBridge, this, _1, _2);
-    ds_bridge->setCallback(cb_bridge);
+    ds_param = NULL;
+    ds_encoder = NULL;
+    ds_bridge = NULL;
+    loadServer(ds_param, mName, &MotorParamConfigurator::reconfigureCBParam, this, !lazy_);
+    loadServer(ds_encoder, mName + PARAM_ENCODER_STRING, &MotorParamConfigurator::reconfigureCBEncoder, this, !lazy_);
+    loadServer(ds_bridge, mName + PARAM_BRIDGE_STRING, &MotorParamConfigurator::reconfigureCBBridge, this, !lazy_);
 }
 
-void MotorParamConfigurator::initConfigurator()
-{    
-    /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.parameter = getParam();
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
-}
-
-void MotorParamConfigurator::setParam(motor_parameter_t parameter) {
-    motor_parameter_encoder_t encoder = parameter.encoder;
-    motor_parameter_bridge_t bridge = parameter.bridge;
-    nh_.setParam(mName + "/ratio", (double) parameter.ratio);
-    nh_.setParam(mName + "/rotation", (int) parameter.rotation);
-
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/h_bridge_enable", (int) bridge.enable);
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/PWM_dead_zone", (int) bridge.pwm_dead_zone);
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/PWM_frequency", (int) bridge.pwm_frequency);
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/volt_offset", (double) bridge.volt_offset);
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/volt_gain", (double) bridge.volt_gain);
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/current_offset", (double) bridge.current_offset);
-    nh_.setParam(mName + PARAM_BRIDGE_STRING + "/current_gain", (double) bridge.current_gain);
-
-    nh_.setParam(mName + PARAM_ENCODER_STRING + "/CPR", (int) encoder.cpr);
-    nh_.setParam(mName + PARAM_ENCODER_STRING + "/position", (int) encoder.type.position);
-    nh_.setParam(mName + PARAM_ENCODER_STRING + "/z_index", (int) encoder.type.z_index);
-    nh_.setParam(mName + PARAM_ENCODER_STRING + "/channels", (int) (encoder.type.channels + 1));
+MotorParamConfigurator::~MotorParamConfigurator()
+{
+    delete ds_param;
+    delete ds_encoder;
+    delete ds_bridge;
 }
 
-motor_parameter_t MotorParamConfigurator::getParam() {
-    motor_parameter_t parameter;
-    int temp_int;
-    double temp_double;
-    nh_.getParam(mName + "/ratio", temp_double);
-    parameter.ratio = (float) temp_double;
-    nh_.getParam(mName + "/rotation", temp_int);
-    parameter.rotation = (int8_t) temp_int;
-    ROS_DEBUG_STREAM("Read param from " << mName << " [Ratio:" << parameter.ratio << ", Rotation:" << (int) parameter.rotation << "]");
-
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/h_bridge_enable", temp_int);
-    parameter.bridge.enable = (uint8_t) temp_int;
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/PWM_dead_zone", temp_int);
-    parameter.bridge.pwm_dead_zone = (uint16_t) temp_int;
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/PWM_frequency", temp_int);
-    parameter.bridge.pwm_frequency = (uint16_t) temp_int;
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/volt_offset", temp_double);
-    parameter.bridge.volt_offset = (float) temp_double;
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/volt_gain", temp_double);
-    parameter.bridge.volt_gain = (float) temp_double;
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/current_offset", temp_double);
-    parameter.bridge.current_offset = (float) temp_double;
-    nh_.getParam(mName + PARAM_BRIDGE_STRING + "/current_gain", temp_double);
-    parameter.bridge.current_gain = (float) temp_double;
-
-    ROS_DEBUG_STREAM("Read param from " << mName << " [Enable:" << (int) parameter.bridge.enable
-                    << ", PWM_Dead_zone:" << parameter.bridge.pwm_dead_zone
-                    << ", PWM_Frequency:" << parameter.bridge.pwm_frequency
-                    << ", Volt_Offset:" << parameter.bridge.volt_offset
-                    << ", Volt_Gain:" << parameter.bridge.volt_gain
-                    << ", Current_Offset:" << parameter.bridge.current_offset
-                    << ", Current_Gain:" << parameter.bridge.current_gain << "]");
-
-    nh_.getParam(mName + PARAM_ENCODER_STRING + "/CPR", temp_int);
-    parameter.encoder.cpr = (uint16_t) temp_int;
-    nh_.getParam(mName + PARAM_ENCODER_STRING + "/position", temp_int);
-    parameter.encoder.type.position = (uint8_t) temp_int;
-    nh_.getParam(mName + PARAM_ENCODER_STRING + "/z_index", temp_int);
-    parameter.encoder.type.z_index = (uint8_t) temp_int;
-    nh_.getParam(mName + PARAM_ENCODER_STRING + "/channels", temp_int);
-    parameter.encoder.type.channels = (uint8_t) (temp_int - 1);
-
-    ROS_DEBUG_STREAM("Read param from " << mName << " [CPR:" << parameter.encoder.cpr
-                    << ", Position:" << (int) parameter.encoder.type.position
-                    << ", Z_index:" << (int) parameter.encoder.type.z_index
-                    << ", Channels:" << (int) parameter.encoder.type.channels << "]");
-
-    return parameter;
+void MotorParamConfigurator::initReconfigure()
+{
+    loadServer(ds_param, mName, &MotorParamConfigurator::reconfigureCBParam, this, true);
+    loadServer(ds_encoder, mName + PARAM_ENCODER_STRING, &MotorParamConfigurator::reconfigureCBEncoder, this, true);
+    loadServer(ds_bridge, mName + PARAM_BRIDGE_STRING, &MotorParamConfigurator::reconfigureCBBridge, this, true);
 }
 
 void MotorParamConfigurator::reconfigureCBParam(orbus_interface::UnavParameterConfig &config, uint32_t level) {
 
-    parameter.ratio = (float) config.ratio;
-    parameter.rotation = (int8_t) config.rotation;
+    // Same conversions of the parameter server
+    ParamFieldRatio::set(parameter, config.ratio);
+    ParamFieldRotation::set(parameter, config.rotation);
 
     //The first time we're called, we just want to make sure we have the
     //original configuration
@@ -157,10 +92,7 @@ void MotorParamConfigurator::reconfigureCBParam(orbus_interface::UnavParameterCo
     }
 
     /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.parameter = parameter;
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
+    updateParam(parameter);
 
     // Store last parameter data
     last_param_ = parameter;
@@ -168,10 +100,11 @@ void MotorParamConfigurator::reconfigureCBParam(orbus_interface::UnavParameterCo
 
 void MotorParamConfigurator::reconfigureCBEncoder(orbus_interface::UnavEncoderConfig &config, uint32_t level) {
 
-    parameter.encoder.cpr = (uint16_t) config.CPR;
-    parameter.encoder.type.position = (uint8_t) config.position;
-    parameter.encoder.type.z_index = (uint8_t) config.z_index;
-    parameter.encoder.type.channels = (uint8_t) (config.channels - 1);
+    // Same conversions of the parameter server
+    EncoderFieldCPR::set(parameter, config.CPR);
+    EncoderFieldPosition::set(parameter, config.position);
+    EncoderFieldZIndex::set(parameter, config.z_index);
+    EncoderFieldChannels::set(parameter, config.channels);
 
     //The first time we're called, we just want to make sure we have the
     //original configuration
@@ -184,10 +117,7 @@ void MotorParamConfigurator::reconfigureCBEncoder(orbus_interface::UnavEncoderCo
     }
 
     /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.parameter = parameter;
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
+    updateParam(parameter);
 
     // Store last parameter data
     last_param_ = parameter;
@@ -195,13 +125,14 @@ void MotorParamConfigurator::reconfigureCBEncoder(orbus_interface::UnavEncoderCo
 
 void MotorParamConfigurator::reconfigureCBBridge(orbus_interface::UnavBridgeConfig &config, uint32_t level) {
 
-    parameter.bridge.enable = (uint8_t) config.h_bridge_enable;
-    parameter.bridge.pwm_dead_zone = (uint16_t) config.PWM_dead_zone;
-    parameter.bridge.pwm_frequency = (uint16_t) config.PWM_frequency;
-    parameter.bridge.volt_offset = (float) config.volt_offset;
-    parameter.bridge.volt_gain = (float) config.volt_gain;
-    parameter.bridge.current_offset = (float) config.current_offset;
-    parameter.bridge.current_gain = (float) config.current_gain;
+    // Same conversions of the parameter server
+    BridgeFieldEnable::set(parameter, config.h_bridge_enable);
+    BridgeFieldDeadZone::set(parameter, config.PWM_dead_zone);
+    BridgeFieldFrequency::set(parameter, config.PWM_frequency);
+    BridgeFieldVoltOffset::set(parameter, config.volt_offset);
+    BridgeFieldVoltGain::set(parameter, config.volt_gain);
+    BridgeFieldCurrentOffset::set(parameter, config.current_offset);
+    BridgeFieldCurrentGain::set(parameter, config.current_gain);
 
     //The first time we're called, we just want to make sure we have the
     //original configuration
@@ -214,10 +145,7 @@ void MotorParamConfigurator::reconfigureCBBridge(orbus_interface::UnavBridgeConf
     }
 
     /// Send configuration to board
-    message_abstract_u temp;
-    temp.motor.parameter = parameter;
-    /// Call the function in Generic Reconfigurator
-    SendParameterToBoard(temp);
+    updateParam(parameter);
 
     // Store last parameter data
     last_param_ = parameter;
@@ -0,0 +1,135 @@
+#include "configurator/ParamSnapshot.h"
+
+#include <cmath>
+
+using namespace std;
+
+ParamSnapshot::ParamSnapshot(const ros::NodeHandle &nh)
+    : mNh(nh)
+    , mLoaded(false)
+{
+}
+
+bool ParamSnapshot::load()
+{
+    mTree.clear();
+    mLoaded = mNh.getParam(mNh.getNamespace(), mTree) && mTree.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+    if(!mLoaded)
+    {
+        ROS_WARN_STREAM("Unable to read the namespace " << mNh.getNamespace() << ", read one parameter at time");
+    }
+    return mLoaded;
+}
+
+void ParamSnapshot::clear()
+{
+    mTree.clear();
+    mLoaded = false;
+}
+
+ParamSnapshot::Key ParamSnapshot::key(const string &name) const
+{
+    Key key;
+    key.name = name;
+    const string &root = mNh.getNamespace();
+    // Only parameters inside the namespace are in the snapshot
+    if(name.compare(0, root.size(), root) != 0 || name.size() <= root.size() || (root != "/" && name[root.size()] != '/'))
+    {
+        return key;
+    }
+    size_t start = root.size();
+    while(start < name.size())
+    {
+        size_t end = name.find('/', start);
+        if(end == string::npos)
+        {
+            end = name.size();
+        }
+        if(end > start)
+        {
+            key.path.push_back(name.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return key;
+}
+
+XmlRpc::XmlRpcValue* ParamSnapshot::find(const Key &key)
+{
+    XmlRpc::XmlRpcValue *node = &mTree;
+    for(unsigned i = 0; i < key.path.size(); ++i)
+    {
+        if(node->getType() != XmlRpc::XmlRpcValue::TypeStruct || !node->hasMember(key.path[i]))
+        {
+            return NULL;
+        }
+        node = &(*node)[key.path[i]];
+    }
+    return node;
+}
+
+bool ParamSnapshot::get(const Key &key, double &value)
+{
+    if(!mLoaded || key.path.empty())
+    {
+        return mNh.getParam(key.name, value);
+    }
+    XmlRpc::XmlRpcValue *node = find(key);
+    if(node == NULL)
+    {
+        return false;
+    }
+    // The parameter server converts the integers
+    if(node->getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    {
+        value = static_cast<double>(*node);
+        return true;
+    }
+    if(node->getType() == XmlRpc::XmlRpcValue::TypeInt)
+    {
+        value = static_cast<int>(*node);
+        return true;
+    }
+    return false;
+}
+
+bool ParamSnapshot::get(const Key &key, int &value)
+{
+    if(!mLoaded || key.path.empty())
+    {
+        return mNh.getParam(key.name, value);
+    }
+    XmlRpc::XmlRpcValue *node = find(key);
+    if(node == NULL)
+    {
+        return false;
+    }
+    // The parameter server rounds the doubles
+    if(node->getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    {
+        double number = static_cast<double>(*node);
+        value = static_cast<int>(fmod(number, 1.0) < 0.5 ? floor(number) : ceil(number));
+        return true;
+    }
+    if(node->getType() == XmlRpc::XmlRpcValue::TypeInt)
+    {
+        value = static_cast<int>(*node);
+        return true;
+    }
+    return false;
+}
+
+bool ParamSnapshot::get(const Key &key, bool &value)
+{
+    if(!mLoaded || key.path.empty())
+    {
+        return mNh.getParam(key.name, value);
+    }
+    XmlRpc::XmlRpcValue *node = find(key);
+    if(node == NULL || node->getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+    {
+        return false;
+    }
+    value = static_cast<bool>(*node);
+    return true;
+}
@@ -0,0 +1,97 @@
+#include "configurator/ParamWriter.h"
+#include "configurator/GenericConfigurator.h"
+
+using namespace std;
+
+ParamWriter::ParamWriter()
+    : mHead(0)
+    , mTail(0)
+    , mRunning(true)
+{
+    for(unsigned int i = 0; i < PARAM_WRITER_SIZE; ++i)
+    {
+        mQueue[i].sequence.store(i, memory_order_relaxed);
+    }
+    mThread = thread(&ParamWriter::worker, this);
+}
+
+ParamWriter::~ParamWriter()
+{
+    mRunning = false;
+    if(mThread.joinable())
+    {
+        mThread.join();
+    }
+}
+
+bool ParamWriter::post(GenericConfigurator *target, const message_abstract_u &message)
+{
+    unsigned int position = mHead.load(memory_order_relaxed);
+    while(true)
+    {
+        param_request_t *cell = &mQueue[position % PARAM_WRITER_SIZE];
+        int diff = (int) cell->sequence.load(memory_order_acquire) - (int) position;
+        if(diff == 0)
+        {
+            // Reserve the cell
+            if(mHead.compare_exchange_weak(position, position + 1, memory_order_relaxed))
+            {
+                cell->target = target;
+                cell->message = message;
+                cell->sequence.store(position + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if(diff < 0)
+        {
+            // Queue full
+            return false;
+        }
+        else
+        {
+            position = mHead.load(memory_order_relaxed);
+        }
+    }
+}
+
+bool ParamWriter::pop(GenericConfigurator *&target, message_abstract_u &message)
+{
+    // Only the worker read from the queue
+    unsigned int position = mTail.load(memory_order_relaxed);
+    param_request_t *cell = &mQueue[position % PARAM_WRITER_SIZE];
+    int diff = (int) cell->sequence.load(memory_order_acquire) - (int) (position + 1);
+    if(diff < 0)
+    {
+        // Queue empty
+        return false;
+    }
+    target = cell->target;
+    message = cell->message;
+    cell->sequence.store(position + PARAM_WRITER_SIZE, memory_order_release);
+    mTail.store(position + 1, memory_order_relaxed);
+    return true;
+}
+
+void ParamWriter::worker()
+{
+    GenericConfigurator *target;
+    message_abstract_u message;
+    while(mRunning)
+    {
+        while(pop(target, message))
+        {
+            target->writeParam(message);
+        }
+        if(GenericConfigurator::mCache != NULL)
+        {
+            GenericConfigurator::mCache->flush();
+        }
+        // The parameter server update is not time critical
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    // Last answers before the stop
+    if(GenericConfigurator::mCache != NULL)
+    {
+        GenericConfigurator::mCache->flush();
+    }
+}
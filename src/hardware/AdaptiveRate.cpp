@@ -0,0 +1,131 @@
+#include "hardware/AdaptiveRate.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ORInterface
+{
+
+AdaptiveRate::AdaptiveRate()
+    : mEnable(false)
+    , mNominal(1.0)
+    , mConfigured(1.0)
+    , mMinimum(1.0)
+    , mLatencyLimit(0.8)
+    , mIdleMin(10.0)
+    , mRecover(5)
+    , mTelemetrySteps(2)
+    , mLevel(0)
+    , mMaxLevel(0)
+    , mHealthy(0)
+    , mReason("nominal")
+{
+}
+
+void AdaptiveRate::setup(const ros::NodeHandle &nh, double frequency)
+{
+    mNominal = frequency;
+    nh.param<bool>("adaptive_rate/enable", mEnable, false);
+    nh.param<double>("adaptive_rate/min_frequency", mConfigured, frequency / 8.0);
+    nh.param<double>("adaptive_rate/latency", mLatencyLimit, mLatencyLimit);
+    nh.param<double>("adaptive_rate/idle", mIdleMin, mIdleMin);
+    int recover = mRecover, telemetry_steps = mTelemetrySteps;
+    nh.param<int>("adaptive_rate/recover_cycles", recover, recover);
+    nh.param<int>("adaptive_rate/telemetry_steps", telemetry_steps, telemetry_steps);
+    mRecover = std::max(recover, 1);
+    mTelemetrySteps = std::max(telemetry_steps, 0);
+    mConfigured = std::min(std::max(mConfigured, 0.0), mNominal);
+    mMinimum = mConfigured;
+    updateLevels();
+}
+
+void AdaptiveRate::updateLevels()
+{
+    // Halve the control loop until the minimum frequency
+    unsigned int control_steps = 0;
+    if(mMinimum > 0)
+    {
+        control_steps = (unsigned int) std::ceil(std::log2(mNominal / mMinimum));
+    }
+    mMaxLevel = mTelemetrySteps + control_steps;
+    mLevel = std::min(mLevel, mMaxLevel);
+}
+
+bool AdaptiveRate::limit(double frequency)
+{
+    double minimum = std::min(std::max(mConfigured, frequency), mNominal);
+    if(minimum == mMinimum)
+    {
+        return false;
+    }
+    mMinimum = minimum;
+    updateLevels();
+    return true;
+}
+
+double AdaptiveRate::frequency() const
+{
+    if(mLevel <= mTelemetrySteps)
+    {
+        return mNominal;
+    }
+    return std::max(mNominal / std::pow(2.0, mLevel - mTelemetrySteps), mMinimum);
+}
+
+unsigned int AdaptiveRate::telemetryScale() const
+{
+    return 1 << std::min(mLevel, mTelemetrySteps);
+}
+
+bool AdaptiveRate::setLevel(unsigned int level, const std::string &reason)
+{
+    mHealthy = 0;
+    if(level == mLevel)
+    {
+        return false;
+    }
+    mLevel = level;
+    mReason = reason;
+    return true;
+}
+
+bool AdaptiveRate::lost()
+{
+    return setLevel(mMaxLevel, "link lost");
+}
+
+bool AdaptiveRate::update(double latency, unsigned long failures, double idle)
+{
+    double period = 1.0 / frequency();
+    // Saturation of the link or the board, one level down
+    const char *saturated = NULL;
+    if(failures > 0)
+    {
+        saturated = "timeout";
+    }
+    else if(latency > mLatencyLimit * period)
+    {
+        saturated = "latency";
+    }
+    else if(idle >= 0 && idle < mIdleMin)
+    {
+        saturated = "board idle";
+    }
+    if(saturated != NULL)
+    {
+        return setLevel(std::min(mLevel + 1, mMaxLevel), saturated);
+    }
+    if(mLevel == 0 || ++mHealthy < mRecover)
+    {
+        return false;
+    }
+    // A faster control loop must still have the time for the transactions
+    if(mLevel > mTelemetrySteps && latency > mLatencyLimit * period / 2.0)
+    {
+        mHealthy = 0;
+        return false;
+    }
+    return setLevel(mLevel - 1, "recovered");
+}
+
+}
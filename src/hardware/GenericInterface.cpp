@@ -1,4 +1,5 @@
 #include "hardware/GenericInterface.h"
+#include "hardware/allocation_check.h"
 
 #include <regex>
 
@@ -25,6 +26,9 @@ GenericInterface::GenericInterface(const ros::NodeHandle &nh, const ros::NodeHan
 
     pub_peripheral = private_mNh.advertise<orbus_interface::Peripheral>("peripheral", 10,
                 boost::bind(&GenericInterface::connectionCallback, this, _1), boost::bind(&GenericInterface::connectionCallback, this, _1));
+    // Publish only with subscribers, with decimation
+    gate_time.setup(private_mNh, "publish/system");
+    gate_peripheral.setup(private_mNh, "publish/peripheral");
     //Subscriber
     sub_peripheral = private_mNh.subscribe("cmd_peripheral", 1, &GenericInterface::gpio_subscriber_Callback, this);
 
@@ -34,6 +38,24 @@ GenericInterface::GenericInterface(const ros::NodeHandle &nh, const ros::NodeHan
     // GPIO
     srv_gpio = private_mNh.advertiseService("gpio", &GenericInterface::gpio_Callback, this);
 
+    // Rate of all streams
+    mScheduler.setup(private_mNh);
+    // Load of the board
+    mThrottle.setup(private_mNh);
+    pub_throttle = private_mNh.advertise<std_msgs::Bool>("throttle", 1, true);
+    msg_throttle.data = false;
+    pub_throttle.publish(msg_throttle);
+
+    // Initialize all GPIO
+    if(private_mNh.hasParam("gpio"))
+    {
+        ROS_INFO("GPIO configuration available.");
+        private_mNh.getParam("gpio", gpio_list);
+    }
+}
+
+bool GenericInterface::requestIdentity()
+{
     // Build a packet
     packet_information_t frame_code_date = CREATE_PACKET_RESPONSE(SYSTEM_CODE_DATE, HASHMAP_SYSTEM, PACKET_REQUEST);
     packet_information_t frame_code_version = CREATE_PACKET_RESPONSE(SYSTEM_CODE_VERSION, HASHMAP_SYSTEM, PACKET_REQUEST);
@@ -44,17 +66,12 @@ GenericInterface::GenericInterface(const ros::NodeHandle &nh, const ros::NodeHan
     if(mSerial->addFrame(frame_code_date)->addFrame(frame_code_version)->addFrame(frame_code_author)->addFrame(frame_code_board_type)->addFrame(frame_code_board_name)->sendList())
     {
         ROS_DEBUG_STREAM("Send Service information messages");
+        return true;
     }
     else
     {
         ROS_ERROR_STREAM("Any messages from board");
-    }
-
-    // Initialize all GPIO
-    if(private_mNh.hasParam("gpio"))
-    {
-        ROS_INFO("GPIO configuration available.");
-        private_mNh.getParam("gpio", gpio_list);
+        return false;
     }
 }
 
@@ -83,6 +100,15 @@ void GenericInterface::connectionCallback(const ros::SingleSubscriberPublisher&
     }
 }
 
+double GenericInterface::boardIdle() const
+{
+    if(msg_system.header.stamp.isZero())
+    {
+        return -1;
+    }
+    return msg_system.idle;
+}
+
 void GenericInterface::setupGPIO(std::vector<int> gpio_list)
 {
     peripheral_gpio_map_t gpio;
@@ -144,8 +170,16 @@ void GenericInterface::initializeDiagnostic()
 void GenericInterface::updateInterface()
 {
     //ROS_INFO_STREAM("Size information: " << information_frames.size());
-    // Send all list of frame required
-    mSerial->addFrame(information_frames)->sendList();
+    // Queue all list of frame required
+    if(mScheduler.due(STREAM_GPIO))
+    {
+        mSerial->addFrame(information_frames);
+    }
+    // The throttle follows the load of the board faster than the diagnostic
+    if(mScheduler.due(STREAM_SYSTEM))
+    {
+        mSerial->addFrame(orbus::request<HASHMAP_SYSTEM, SYSTEM_TIME>());
+    }
 }
 
 void GenericInterface::run(diagnostic_updater::DiagnosticStatusWrapper &stat) {
@@ -174,8 +208,17 @@ void GenericInterface::run(diagnostic_updater::DiagnosticStatusWrapper &stat) {
     stat.add("LED (nS)", (int) msg_system.led);
     stat.add("Serial parser (nS)", (int) msg_system.serial_parser);
     stat.add("I2C (nS)", (int) msg_system.I2C);
+    stat.add("Parser average (nS)", (int) mThrottle.parserAverage());
+    stat.add("Throttle", mThrottle.active());
 
-    stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Board ready!");
+    if(mThrottle.active())
+    {
+        stat.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Board overloaded, telemetry throttled");
+    }
+    else
+    {
+        stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Board ready!");
+    }
 }
 
 void GenericInterface::convertGPIO(peripherals_gpio_port_t data) {
@@ -188,18 +231,19 @@ void GenericInterface::convertGPIO(peripherals_gpio_port_t data) {
     }
 }
 
-void GenericInterface::peripheralFrame(unsigned char option, unsigned char type, unsigned char command, message_abstract_u message) {
+void GenericInterface::peripheralFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
     ROS_DEBUG_STREAM("Frame [Option: " << option << ", HashMap: " << type << ", Command: " << (int) command << "]");
     peripheral_gpio_map_t peripheral;
     peripheral.message = command;
     switch(peripheral.bitset.command)
     {
     case PERIPHERALS_GPIO_DIGITAL:
-        if(option == PACKET_DATA)
+        if(option == PACKET_DATA && gate_peripheral.due(pub_peripheral))
         {
             convertGPIO(message.gpio.port);
             // publish a message
             msg_peripheral.header.stamp = ros::Time::now();
+            orbus::allocation::pause unchecked;
             pub_peripheral.publish(msg_peripheral);
         }
         break;
@@ -215,7 +259,7 @@ void GenericInterface::peripheralFrame(unsigned char option, unsigned char type,
     }
 }
 
-void GenericInterface::systemFrame(unsigned char option, unsigned char type, unsigned char command, message_abstract_u message) {
+void GenericInterface::systemFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
     ROS_DEBUG_STREAM("Frame [Option: " << option << ", HashMap: " << type << ", Command: " << command << "]");
     switch (command) {
     case SYSTEM_CODE_DATE:
@@ -234,15 +278,40 @@ void GenericInterface::systemFrame(unsigned char option, unsigned char type, uns
         code_board_name = string((char*)message.system.service);
         break;
     case SYSTEM_TIME:
-        msg_system.idle = message.system.time.idle;
-        msg_system.ADC = message.system.time.adc;
-        msg_system.led = message.system.time.led;
-        msg_system.serial_parser = message.system.time.parser;
-        msg_system.I2C = message.system.time.i2c;
+    {
+        const ORBUS_PAYLOAD(system.time) &time = orbus::decode<HASHMAP_SYSTEM, SYSTEM_TIME>(message);
+        msg_system.idle = time.idle;
+        msg_system.ADC = time.adc;
+        msg_system.led = time.led;
+        msg_system.serial_parser = time.parser;
+        msg_system.I2C = time.i2c;
         // publish a message
         msg_system.header.stamp = ros::Time::now();
-        pub_time.publish(msg_system);
+        // The times are also used from the diagnostic and the throttle, only the publish is skipped
+        if(gate_time.due(pub_time))
+        {
+            orbus::allocation::pause unchecked;
+            pub_time.publish(msg_system);
+        }
+        // Protect the control of the board from the requests
+        if(mThrottle.update(time.idle, time.parser))
+        {
+            // Publish and log only on a change, not checked
+            orbus::allocation::pause unchecked;
+            mScheduler.setThrottle(mThrottle.scale());
+            msg_throttle.data = mThrottle.active();
+            pub_throttle.publish(msg_throttle);
+            if(mThrottle.active())
+            {
+                ROS_WARN_STREAM("THROTTLE - Board idle " << time.idle << "% - parser " << time.parser << "nS, telemetry 1:" << mScheduler.divisor(STREAM_TELEMETRY));
+            }
+            else
+            {
+                ROS_INFO_STREAM("THROTTLE - Released, board idle " << time.idle << "%");
+            }
+        }
         break;
+    }
     default:
         ROS_ERROR_STREAM("System message \""<< command << "\"=(" << (int) command << ")" << " does not implemented!");
         break;
@@ -263,14 +332,8 @@ void GenericInterface::gpio_subscriber_Callback(const orbus_interface::Periphera
     }
     //ROS_INFO_STREAM("Gpio: " << port.port);
 
-    peripheral_gpio_map_t gpio;
-    gpio.bitset.command = PERIPHERALS_GPIO_DIGITAL;
-    gpio.bitset.port = 1;
-    // Build a packet
-    message_abstract_u temp;
-    temp.gpio.port.len = port.len;
-    temp.gpio.port.port = port.port;
-    packet_information_t frame = CREATE_PACKET_DATA(gpio.message, HASHMAP_PERIPHERALS, temp);
+    // Build a packet for the port 1
+    packet_information_t frame = orbus::encode<HASHMAP_PERIPHERALS, PERIPHERALS_GPIO_DIGITAL>(1, port);
     // Send new configuration
     mSerial->addFrame(frame)->sendList();
 }
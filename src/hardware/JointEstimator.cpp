@@ -0,0 +1,87 @@
+#include "hardware/JointEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ORInterface
+{
+
+const double JointEstimator::TICK = 1e-9;
+
+JointEstimator::JointEstimator()
+    : mTicks(0)
+    , mPosition(0)
+    , mVelocity(0)
+    , mAlpha(0.5)
+    , mBeta(0.1)
+    , mVelocityGain(0.5)
+    , mMaxHorizon(0.1)
+    , mValid(false)
+{
+}
+
+void JointEstimator::setup(double alpha, double beta, double velocity_gain, double max_horizon)
+{
+    // With alpha and beta in [0, 1] the filter is always stable
+    mAlpha = std::min(std::max(alpha, 0.0), 1.0);
+    mBeta = std::min(std::max(beta, 0.0), 1.0);
+    mVelocityGain = std::min(std::max(velocity_gain, 0.0), 1.0);
+    mMaxHorizon = std::max(max_horizon, 0.0);
+}
+
+void JointEstimator::reset(double position)
+{
+    mTicks = llround(position / TICK);
+    mPosition = position;
+    mVelocity = 0;
+    mValid = false;
+}
+
+void JointEstimator::update(double position_delta, double velocity, const ros::Time& stamp)
+{
+    // Exact accumulation of the raw position
+    mTicks += llround(position_delta / TICK);
+    double measure = ((double) mTicks) * TICK;
+    // The first measure initialize the filter
+    if(!mValid)
+    {
+        mPosition = measure;
+        mVelocity = velocity;
+        mStamp = stamp;
+        mValid = true;
+        return;
+    }
+    double dt = (stamp - mStamp).toSec();
+    if(dt < 0)
+    {
+        dt = 0;
+    }
+    // Predict to the acquisition time
+    double position = mPosition + mVelocity * dt;
+    // Correct with the residual on position
+    double residual = measure - position;
+    mPosition = position + mAlpha * residual;
+    if(dt > 0)
+    {
+        mVelocity += mBeta * residual / dt;
+    }
+    // Blend the velocity measured from the board at the same time
+    mVelocity += mVelocityGain * (velocity - mVelocity);
+    mStamp = stamp;
+}
+
+void JointEstimator::predict(const ros::Time& stamp, double &position, double &velocity) const
+{
+    if(!mValid)
+    {
+        position = ((double) mTicks) * TICK;
+        velocity = 0;
+        return;
+    }
+    // Saturate the horizon, an old measure must not be extrapolated forever
+    double horizon = std::min(std::max((stamp - mStamp).toSec(), 0.0), mMaxHorizon);
+    position = mPosition + mVelocity * horizon;
+    velocity = mVelocity;
+}
+
+}
@@ -0,0 +1,112 @@
+#include "hardware/LinkBudget.h"
+
+#include <or_bus/or_message.h>
+#include <or_bus/or_frame.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ORInterface
+{
+
+// Bits on the wire for each byte, 8N1
+#define LINK_BITS_BYTE 10.0
+// Overhead of a packet, header and checksum
+#define LINK_PACKET_OVERHEAD (LNG_PACKET_HEADER + 1)
+// Maximum bytes of the frames in a packet
+#define LINK_PACKET_CAPACITY (MAX_BUFF_TX - LINK_PACKET_OVERHEAD)
+
+LinkBudget::LinkBudget()
+    : mBaudrate(115200)
+    , mFrequency(1.0)
+    , mLimit(0.8)
+    , mDefaultTurnaround(0.001)
+    , mRefuse(false)
+    , mStatus(LINK_OK)
+    , mBytes(0)
+    , mUtilization(0)
+    , mMaxRate(0)
+    , mTurnaround(0)
+{
+    for(unsigned i = 0; i < STREAM_SIZE; ++i)
+    {
+        mTx[i] = 0;
+        mRx[i] = 0;
+        mDivisor[i] = 1;
+    }
+}
+
+void LinkBudget::setup(const ros::NodeHandle &nh, unsigned long baudrate, double frequency)
+{
+    mBaudrate = (baudrate > 0 ? baudrate : 1);
+    mFrequency = frequency;
+    nh.param<double>("link_budget/limit", mLimit, mLimit);
+    nh.param<double>("link_budget/turnaround", mDefaultTurnaround, mDefaultTurnaround);
+    std::string mode;
+    nh.param<std::string>("link_budget/mode", mode, "warn");
+    mRefuse = (mode == "refuse");
+}
+
+void LinkBudget::setStream(stream_t stream, size_t tx, size_t rx, unsigned int divisor)
+{
+    mTx[stream] = tx;
+    mRx[stream] = rx;
+    mDivisor[stream] = (divisor > 0 ? divisor : 1);
+}
+
+double LinkBudget::cycleTime(double read_bytes, double write_bytes) const
+{
+    // A transaction is split in more packets, each one waits the answer of the board
+    double packets = 0;
+    if(read_bytes > 0)
+    {
+        packets += std::ceil(read_bytes / LINK_PACKET_CAPACITY);
+    }
+    if(write_bytes > 0)
+    {
+        packets += std::ceil(write_bytes / LINK_PACKET_CAPACITY);
+    }
+    // Request and reply of each packet are on the wire one after the other
+    double bytes = read_bytes + write_bytes + 2 * packets * LINK_PACKET_OVERHEAD;
+    return bytes * LINK_BITS_BYTE / mBaudrate + packets * mTurnaround;
+}
+
+link_status_t LinkBudget::plan(double turnaround)
+{
+    mTurnaround = (turnaround > 0 ? turnaround : mDefaultTurnaround);
+    // The commands are in the write transaction, all requests in the read transaction
+    double read_average = 0, read_peak = 0;
+    for(unsigned i = 0; i < STREAM_SIZE; ++i)
+    {
+        if(i == STREAM_COMMAND)
+        {
+            continue;
+        }
+        double bytes = mTx[i] + mRx[i];
+        read_average += bytes / mDivisor[i];
+        read_peak += bytes;
+    }
+    double write_peak = mTx[STREAM_COMMAND] + mRx[STREAM_COMMAND];
+    double write_average = write_peak / mDivisor[STREAM_COMMAND];
+
+    mBytes = read_average + write_average;
+    mUtilization = cycleTime(read_average, write_average) * mFrequency;
+    double peak = cycleTime(read_peak, write_peak);
+    mMaxRate = (peak > 0 ? 1.0 / peak : 0);
+
+    if(mUtilization > 1.0)
+    {
+        mStatus = LINK_OVERLOAD;
+    }
+    else if(mUtilization > mLimit || mMaxRate < mFrequency)
+    {
+        mStatus = LINK_WARNING;
+    }
+    else
+    {
+        mStatus = LINK_OK;
+    }
+    return mStatus;
+}
+
+}
@@ -0,0 +1,71 @@
+#include "hardware/LoadThrottle.h"
+
+#include <algorithm>
+
+namespace ORInterface
+{
+
+LoadThrottle::LoadThrottle()
+    : mEnable(true)
+    , mIdleMin(20.0)
+    , mParserSpike(3.0)
+    , mHysteresis(0.25)
+    , mSustain(5)
+    , mSpikes(0)
+    , mScale(4)
+    , mParser(0)
+    , mActive(false)
+{
+}
+
+void LoadThrottle::setup(const ros::NodeHandle &nh)
+{
+    nh.param<bool>("board_load/enable", mEnable, mEnable);
+    nh.param<double>("board_load/idle", mIdleMin, mIdleMin);
+    nh.param<double>("board_load/parser_spike", mParserSpike, mParserSpike);
+    nh.param<double>("board_load/hysteresis", mHysteresis, mHysteresis);
+    int scale = mScale, sustain = mSustain;
+    nh.param<int>("board_load/scale", scale, scale);
+    nh.param<int>("board_load/sustain", sustain, sustain);
+    mScale = std::max(scale, 1);
+    mSustain = std::max(sustain, 1);
+    mHysteresis = std::min(std::max(mHysteresis, 0.0), 0.9);
+}
+
+bool LoadThrottle::update(double idle, double parser)
+{
+    if(!mEnable)
+    {
+        return false;
+    }
+    // The first frame is the reference of the parser
+    if(mParser <= 0)
+    {
+        mParser = parser;
+    }
+    bool spike = (parser > mParser * mParserSpike);
+    bool active = mActive;
+    if(!mActive)
+    {
+        active = (idle < mIdleMin || spike);
+    }
+    else
+    {
+        // Release only inside the hysteresis
+        active = !(idle > mIdleMin * (1.0 + mHysteresis) && parser < mParser * mParserSpike * (1.0 - mHysteresis));
+    }
+    // The single spikes do not move the average, a sustained load does
+    mSpikes = (spike ? mSpikes + 1 : 0);
+    if(!spike || mSpikes >= mSustain)
+    {
+        mParser = 0.9 * mParser + 0.1 * parser;
+    }
+    if(active == mActive)
+    {
+        return false;
+    }
+    mActive = active;
+    return true;
+}
+
+}
@@ -1,5 +1,6 @@
 
 #include "hardware/Motor.h"
+#include "hardware/allocation_check.h"
 
 #include <hardware_interface/joint_state_interface.h>
 #include <hardware_interface/joint_command_interface.h>
@@ -7,17 +8,30 @@
 #include <joint_limits_interface/joint_limits_urdf.h>
 #include <joint_limits_interface/joint_limits_rosparam.h>
 
+#include <algorithm>
+
 namespace ORInterface
 {
 
-Motor::Motor(const ros::NodeHandle& nh, orbus::serial_controller *serial, string name, unsigned int number)
+Motor::Motor(const ros::NodeHandle& nh, orbus::serial_controller *serial, joint_table_t *table, string name, unsigned int number)
     : DiagnosticTask(name + "_status")
-    , joint_state_handle(name, &position, &velocity, &effort)
-    , joint_handle(joint_state_handle, &command)
+    , joint_state_handle(name, &table->position[number], &table->velocity[number], &table->effort[number])
+    , joint_handle(joint_state_handle, &table->command[number])
     , mNh(nh)
     , mSerial(serial)
+    , mState(table->state[number])
+    , position(table->position[number])
+    , velocity(table->velocity[number])
+    , effort(table->effort[number])
+    , command(table->command[number])
 {
-    motor_command.bitset.motor = number;
+    // Initialize the state in the joint table
+    mState = STATE_CONTROL_DISABLE;
+    position = 0;
+    velocity = 0;
+    effort = 0;
+    command = 0;
+
     mNumber = number;
 
     mMotorName = name;
@@ -37,12 +51,103 @@ Motor::Motor(const ros::NodeHandle& nh, orbus::serial_controller *serial, string
     pub_measure = mNh.advertise<orbus_interface::ControlStatus>(mMotorName + "/measure", 10);
     pub_control = mNh.advertise<orbus_interface::ControlStatus>(mMotorName + "/control", 10,
             boost::bind(&Motor::connectionCallback, this, _1), boost::bind(&Motor::connectionCallback, this, _1));
+    // Publish only with subscribers, with decimation
+    gate_status.setup(mNh, mMotorName + "/publish/status");
+    gate_measure.setup(mNh, mMotorName + "/publish/measure");
+    memset(&last_measure, 0, sizeof(last_measure));
 
     //Load limits dynamic reconfigure
-    dsrv = new dynamic_reconfigure::Server<orbus_interface::UnavLimitsConfig>(config_mutex, ros::NodeHandle("~" + mMotorName + "/limits"));
-    dynamic_reconfigure::Server<orbus_interface::UnavLimitsConfig>::CallbackType cb = boost::bind(&Motor::reconfigureCB, this, _1, _2);
-    dsrv->setCallback(cb);
+    dsrv = NULL;
+    setup_ = false;
+    last_config_ = orbus_interface::UnavLimitsConfig::__getDefault__();
+    mNh.param<bool>("lazy_reconfigure", lazy_reconfigure, false);
+    if(lazy_reconfigure)
+    {
+        // Initialize the limits as the server does, without topics and services
+        ros::NodeHandle nh_limits("~" + mMotorName + "/limits");
+        orbus_interface::UnavLimitsConfig config = orbus_interface::UnavLimitsConfig::__getDefault__();
+        config.__fromServer__(nh_limits);
+        config.__clamp__();
+        config.__toServer__(nh_limits);
+        reconfigureCB(config, ~0);
+        // Service to start all servers of this motor
+        srv_reconfigure = mNh.advertiseService(mMotorName + "/reconfigure", &Motor::reconfigure_Callback, this);
+    }
+    else
+    {
+        initReconfigure();
+    }
     first = true;
+
+    // Load estimator configuration
+    mNh.param<bool>(mMotorName + "/estimator/enable", estimator_enable, false);
+    if(estimator_enable)
+    {
+        double alpha, beta, velocity_gain, horizon;
+        mNh.param<double>(mMotorName + "/estimator/alpha", alpha, 0.5);
+        mNh.param<double>(mMotorName + "/estimator/beta", beta, 0.1);
+        mNh.param<double>(mMotorName + "/estimator/velocity_gain", velocity_gain, 0.5);
+        mNh.param<double>(mMotorName + "/estimator/max_horizon", horizon, 0.1);
+        estimator.setup(alpha, beta, velocity_gain, horizon);
+        ROS_INFO_STREAM("Motor [" << mMotorName << "] estimator enabled [alpha:" << alpha << ", beta:" << beta
+                        << ", velocity gain:" << velocity_gain << ", horizon:" << horizon << "s]");
+    }
+
+    // Load host side safety configuration
+    string reaction;
+    double hysteresis;
+    mNh.param<string>(mMotorName + "/safety/reaction", reaction, "warn");
+    mNh.param<double>(mMotorName + "/safety/hysteresis", hysteresis, 0.05);
+    mNh.param<double>(mMotorName + "/safety/derate", safety_derate, 0.5);
+    if(reaction == "derate")
+    {
+        safety_reaction = SAFETY_REACTION_DERATE;
+    }
+    else if(reaction == "estop")
+    {
+        safety_reaction = SAFETY_REACTION_ESTOP;
+    }
+    else
+    {
+        if(reaction != "warn")
+        {
+            ROS_WARN_STREAM("Motor [" << mMotorName << "] unknown safety reaction " << reaction << ", only warn");
+        }
+        safety_reaction = SAFETY_REACTION_WARN;
+    }
+    current_safety.setup(hysteresis);
+    temperature_safety.setup(hysteresis);
+
+    // Load the suppression of the references
+    mNh.param<bool>(mMotorName + "/command/deduplicate", command_dedup, false);
+    mNh.param<double>(mMotorName + "/command/keepalive", command_keepalive, 0.05);
+    command_valid = false;
+    last_reference = 0;
+    commands_sent = 0;
+    commands_suppressed = 0;
+}
+
+void Motor::initReconfigure()
+{
+    if(dsrv == NULL)
+    {
+        dsrv = new dynamic_reconfigure::Server<orbus_interface::UnavLimitsConfig>(config_mutex, ros::NodeHandle("~" + mMotorName + "/limits"));
+        dynamic_reconfigure::Server<orbus_interface::UnavLimitsConfig>::CallbackType cb = boost::bind(&Motor::reconfigureCB, this, _1, _2);
+        dsrv->setCallback(cb);
+    }
+    pid_velocity->initReconfigure();
+    pid_current->initReconfigure();
+    parameter->initReconfigure();
+    emergency->initReconfigure();
+    diagnostic_current->initReconfigure();
+    diagnostic_temperature->initReconfigure();
+}
+
+bool Motor::reconfigure_Callback(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
+{
+    ROS_INFO_STREAM("Start dynamic reconfigure for " << mMotorName);
+    initReconfigure();
+    return true;
 }
 
 void Motor::connectionCallback(const ros::SingleSubscriberPublisher& pub)
@@ -53,23 +158,29 @@ void Motor::connectionCallback(const ros::SingleSubscriberPublisher& pub)
     ROS_DEBUG_STREAM("Num referecence: " << pub_reference.getNumSubscribers());
     if(pub_reference.getNumSubscribers() >= 1)
     {
-        // Motor control
-        motor_command.bitset.command = MOTOR_REFERENCE;
         // Build a packet
-        packet_information_t frame_reference = CREATE_PACKET_RESPONSE(motor_command.command_message, HASHMAP_MOTOR, PACKET_REQUEST);
+        packet_information_t frame_reference = orbus::request<HASHMAP_MOTOR, MOTOR_REFERENCE>(mNumber);
         information_motor.push_back(frame_reference);
     }
     ROS_DEBUG_STREAM("Num control: " << pub_control.getNumSubscribers());
     if(pub_control.getNumSubscribers() >= 1)
     {
-        // Motor control
-        motor_command.bitset.command = MOTOR_CONTROL;
         // Build a packet
-        packet_information_t frame_control = CREATE_PACKET_RESPONSE(motor_command.command_message, HASHMAP_MOTOR, PACKET_REQUEST);
+        packet_information_t frame_control = orbus::request<HASHMAP_MOTOR, MOTOR_CONTROL>(mNumber);
         information_motor.push_back(frame_control);
     }
 }
 
+Motor::~Motor()
+{
+    delete pid_velocity;
+    delete pid_current;
+    delete parameter;
+    delete emergency;
+    delete diagnostic_current;
+    delete diagnostic_temperature;
+}
+
 void Motor::initializeMotor()
 {
     // Initialize ONLY diagnostic current
@@ -79,6 +190,12 @@ void Motor::initializeMotor()
     pid_current->initConfigurator();
     parameter->initConfigurator();
     emergency->initConfigurator();
+    // The board may be restarted, send again the reference
+    command_valid = false;
+    if(command_dedup && command_keepalive * 1000.0 > emergency->timeout() / 2.0)
+    {
+        ROS_WARN_STREAM("Motor [" << mMotorName << "] keepalive " << command_keepalive * 1000.0 << "ms reduced to half of the emergency timeout " << emergency->timeout() << "ms");
+    }
 
     //Skip first limits initialization
     if(first)
@@ -105,16 +222,19 @@ void Motor::updateLimits(double position, double velocity, double effort)
     last_config_.velocity = velocity;
     last_config_.effort = effort;
 
-    dsrv->updateConfig(last_config_);
+    if(dsrv != NULL)
+    {
+        dsrv->updateConfig(last_config_);
+    }
+    else
+    {
+        last_config_.__toServer__(ros::NodeHandle("~" + mMotorName + "/limits"));
+    }
 
     ROS_DEBUG_STREAM("LIMITS param [pos:" << constraints.position << ", vel:" << constraints.velocity << ", curr:" << constraints.current << ", eff:" << constraints.effort <<", PWM:" << constraints.pwm << "]");
 
-    // Set type of command
-    motor_command.bitset.command = MOTOR_CONSTRAINT;
     // Build a packet
-    message_abstract_u temp;
-    temp.motor.motor = constraints;
-    packet_information_t frame_constraints = CREATE_PACKET_DATA(motor_command.command_message, HASHMAP_MOTOR, temp);
+    packet_information_t frame_constraints = orbus::encode<HASHMAP_MOTOR, MOTOR_CONSTRAINT>(mNumber, constraints);
     // Add packet in the frame
     mSerial->addFrame(frame_constraints);
 }
@@ -147,7 +267,7 @@ void Motor::reconfigureCB(orbus_interface::UnavLimitsConfig &config, uint32_t le
     updateLimits(config.position, config.velocity, config.effort);
 }
 
-void Motor::setupLimits(urdf::Model model)
+void Motor::setupLimits(const urdf::Model &model)
 {
     /// Add a velocity joint limits infomations
     joint_limits_interface::JointLimits limits;
@@ -217,10 +337,8 @@ void Motor::setupLimits(urdf::Model model)
 
 void Motor::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
 {
-    // Set type of command
-    motor_command.bitset.command = MOTOR_DIAGNOSTIC;
     // Build a packet
-    packet_information_t frame = CREATE_PACKET_RESPONSE(motor_command.command_message, HASHMAP_MOTOR, PACKET_REQUEST);
+    packet_information_t frame = orbus::request<HASHMAP_MOTOR, MOTOR_DIAGNOSTIC>(mNumber);
     // Add packet in the frame
     if(mSerial->addFrame(frame)->sendList())
     {
@@ -231,6 +349,7 @@ void Motor::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
         ROS_ERROR_STREAM("Unable to receive packet from uNav");
     }
 
+    convertMeasure();
     stat.add("State ", msg_status.state);
     stat.add("PWM rate (%)", msg_measure.pwm);
     stat.add("Voltage (V)", msg_status.voltage);
@@ -242,6 +361,8 @@ void Motor::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
     stat.add("Velociy (RPM)", ((double)msg_measure.velocity) * (30.0 / M_PI));
     stat.add("Current (A)", fabs(msg_measure.current));
     stat.add("Torque (Nm)", msg_measure.effort);
+    stat.add("Commands sent", commands_sent);
+    stat.add("Commands suppressed", commands_suppressed);
 
     stat.summary(diagnostic_msgs::DiagnosticStatus::OK, "Motor Ready!");
 
@@ -281,7 +402,7 @@ void Motor::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
     }
 }
 
-string Motor::convert_status(motor_state_t status)
+const char *Motor::convert_status(motor_state_t status)
 {
     switch(status)
     {
@@ -304,60 +425,120 @@ string Motor::convert_status(motor_state_t status)
     }
 }
 
-void Motor::motorFrame(unsigned char option, unsigned char type, unsigned char command, motor_frame_u frame)
+void Motor::convertMeasure()
+{
+    msg_measure.pwm = ((double) last_measure.pwm) * 100.0 / 2048;
+    msg_measure.position = last_measure.position;
+    msg_measure.velocity = ((double)last_measure.velocity) / 1000.0;
+    msg_measure.current = ((double) last_measure.current) / 1000.0;
+    msg_measure.effort = ((double) last_measure.effort) / 1000.0;
+}
+
+const orbus_interface::ControlStatus &Motor::measure()
+{
+    convertMeasure();
+    return msg_measure;
+}
+
+void Motor::motorFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message)
 {
     ROS_DEBUG_STREAM("Motor decode " << mMotorName );
+    safety_level_t level;
+    double measure_current, measure_velocity;
+    ros::Time stamp;
     switch(command)
     {
     case MOTOR_MEASURE:
-       // ROS_INFO_STREAM("Measure Motor[" << mNumber << "] current: " << frame.motor.current);
-        msg_measure.pwm = ((double) frame.motor.pwm) * 100.0 / 2048;
-        msg_measure.position = frame.motor.position;
-        msg_measure.velocity = ((double)frame.motor.velocity) / 1000.0;
-        msg_measure.current = ((double) frame.motor.current) / 1000.0;
-        msg_measure.effort = ((double) frame.motor.effort) / 1000.0;
+    {
+        const ORBUS_PAYLOAD(motor.motor) &measure = orbus::decode<HASHMAP_MOTOR, MOTOR_MEASURE>(message);
+        last_measure = measure;
+        measure_current = ((double) measure.current) / 1000.0;
+        measure_velocity = ((double) measure.velocity) / 1000.0;
+        // Time of the measure on the board, now for a measure not requested
+        stamp = (measure_stamp.isZero() ? ros::Time::now() : measure_stamp);
+        measure_stamp = ros::Time();
         // publish a message
-        msg_measure.header.stamp = ros::Time::now();
-        pub_measure.publish(msg_measure);
+        if(gate_measure.due(pub_measure))
+        {
+            convertMeasure();
+            msg_measure.header.stamp = stamp;
+            // The serialization of the message is not checked
+            orbus::allocation::pause unchecked;
+            pub_measure.publish(msg_measure);
+        }
+        // Check the current on each measure
+        level = current_safety.level();
+        if(current_safety.update(fabs(measure_current), diagnostic_current->levels.warning, diagnostic_current->levels.critical) != level)
+        {
+            safetyEvent("Current", current_safety.level(), measure_current);
+        }
         // Update joint status
-        effort = msg_measure.effort;
-        position += frame.motor.position_delta;
-        velocity = msg_measure.velocity;
+        effort = ((double) measure.effort) / 1000.0;
+        if(estimator_enable)
+        {
+            estimator.update(measure.position_delta, measure_velocity, stamp);
+        }
+        else
+        {
+            position += measure.position_delta;
+            velocity = measure_velocity;
+        }
         break;
+    }
     case MOTOR_CONTROL:
-        // ROS_INFO_STREAM("Control Motor[" << mNumber << "] current: " << frame.motor.current);
-        msg_control.position = frame.motor.position;
-        msg_control.velocity = ((double)frame.motor.velocity) / 1000.0;
-        msg_control.current = ((double) frame.motor.current) / 1000.0;
+    {
+        const ORBUS_PAYLOAD(motor.motor) &control = orbus::decode<HASHMAP_MOTOR, MOTOR_CONTROL>(message);
+        msg_control.position = control.position;
+        msg_control.velocity = ((double)control.velocity) / 1000.0;
+        msg_control.current = ((double) control.current) / 1000.0;
         // publish a message
         msg_control.header.stamp = ros::Time::now();
+        orbus::allocation::pause unchecked;
         pub_control.publish(msg_control);
         break;
+    }
     case MOTOR_REFERENCE:
-        // ROS_INFO_STREAM("Reference Motor[" << mNumber << "] current: " << frame.motor.current);
-        msg_reference.pwm = ((double) frame.motor.pwm) * 100.0 / 2048;
-        msg_reference.position = frame.motor.position;
-        msg_reference.velocity = ((double)frame.motor.velocity) / 1000.0;
-        msg_reference.current = ((double) frame.motor.current) / 1000.0;
+    {
+        const ORBUS_PAYLOAD(motor.motor) &reference = orbus::decode<HASHMAP_MOTOR, MOTOR_REFERENCE>(message);
+        msg_reference.pwm = ((double) reference.pwm) * 100.0 / 2048;
+        msg_reference.position = reference.position;
+        msg_reference.velocity = ((double)reference.velocity) / 1000.0;
+        msg_reference.current = ((double) reference.current) / 1000.0;
         // publish a message
         msg_reference.header.stamp = ros::Time::now();
+        orbus::allocation::pause unchecked;
         pub_reference.publish(msg_reference);
         break;
+    }
     case MOTOR_DIAGNOSTIC:
-        mDiagnosticState = frame.diagnostic.state;
-        msg_status.state = convert_status(frame.diagnostic.state);
-        msg_status.watt = (frame.diagnostic.watt/1000.0); /// in W
-        msg_status.time_execution = frame.diagnostic.time_control;
-        msg_status.voltage = (frame.diagnostic.volt/1000.0); /// in V;
-        msg_status.temperature = frame.diagnostic.temperature;
-        // publish a message
-        msg_status.header.stamp = ros::Time::now();
-        pub_status.publish(msg_status);
+    {
+        const ORBUS_PAYLOAD(motor.diagnostic) &diagnostic = orbus::decode<HASHMAP_MOTOR, MOTOR_DIAGNOSTIC>(message);
+        mDiagnosticState = diagnostic.state;
+        // Assign from a literal, the string keeps its capacity
+        msg_status.state = convert_status(diagnostic.state);
+        msg_status.watt = (diagnostic.watt/1000.0); /// in W
+        msg_status.time_execution = diagnostic.time_control;
+        msg_status.voltage = (diagnostic.volt/1000.0); /// in V;
+        msg_status.temperature = diagnostic.temperature;
+        // Check the temperature on each diagnostic
+        level = temperature_safety.level();
+        if(temperature_safety.update(msg_status.temperature, diagnostic_temperature->levels.warning, diagnostic_temperature->levels.critical) != level)
+        {
+            safetyEvent("Temperature", temperature_safety.level(), msg_status.temperature);
+        }
+        // The status is also the state of the diagnostic, only the publish is skipped
+        if(gate_status.due(pub_status))
+        {
+            msg_status.header.stamp = ros::Time::now();
+            orbus::allocation::pause unchecked;
+            pub_status.publish(msg_status);
+        }
         break;
+    }
     case MOTOR_STATE:
         if(option == PACKET_DATA)
         {
-            mState = frame.state;
+            mState = orbus::decode<HASHMAP_MOTOR, MOTOR_STATE>(message);
             //ROS_INFO_STREAM("Motor state: " << convert_status(mState));
         } else if(option != PACKET_ACK) {
             ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
@@ -367,35 +548,66 @@ void Motor::motorFrame(unsigned char option, unsigned char type, unsigned char c
         if(option == PACKET_DATA)
         {
             ROS_INFO_STREAM("Velocity PID frame");
-            pid_velocity->setParam(frame.pid);
-        } else if(option != PACKET_ACK) {
-            ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            pid_velocity->setParam(orbus::decode<HASHMAP_MOTOR, MOTOR_VEL_PID>(message));
+        } else {
+            // Answer to a configuration sent
+            pid_velocity->answer(option);
+            if(option != PACKET_ACK)
+            {
+                ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            }
         }
         break;
     case MOTOR_CURRENT_PID:
         if(option == PACKET_DATA)
         {
             ROS_INFO_STREAM("Current PID frame");
-            pid_current->setParam(frame.pid);
-        } else if(option != PACKET_ACK) {
-            ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            pid_current->setParam(orbus::decode<HASHMAP_MOTOR, MOTOR_CURRENT_PID>(message));
+        } else {
+            // Answer to a configuration sent
+            pid_current->answer(option);
+            if(option != PACKET_ACK)
+            {
+                ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            }
         }
         break;
     case MOTOR_EMERGENCY:
         if(option == PACKET_DATA)
         {
             ROS_INFO_STREAM("Emergency frame");
-            emergency->setParam(frame.emergency);
-        } else if(option != PACKET_ACK) {
-            ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            emergency->setParam(orbus::decode<HASHMAP_MOTOR, MOTOR_EMERGENCY>(message));
+        } else {
+            // Answer to a configuration sent
+            emergency->answer(option);
+            if(option != PACKET_ACK)
+            {
+                ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            }
         }
         break;
     case MOTOR_PARAMETER:
         if(option == PACKET_DATA)
         {
             ROS_INFO_STREAM("Parameter frame");
-            parameter->setParam(frame.parameter);
-        } else if(option != PACKET_ACK) {
+            parameter->setParam(orbus::decode<HASHMAP_MOTOR, MOTOR_PARAMETER>(message));
+        } else {
+            // Answer to a configuration sent
+            parameter->answer(option);
+            if(option != PACKET_ACK)
+            {
+                ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
+            }
+        }
+        break;
+    case MOTOR_SAFETY:
+        if(option != PACKET_DATA)
+        {
+            // Answer to a configuration sent
+            diagnostic_current->answer(option);
+        }
+        if(option != PACKET_ACK)
+        {
             ROS_ERROR_STREAM("ERROR "<< option << " Motor[" << mNumber << "] message \""<< command << "\"=(" << (int) command << ")");
         }
         break;
@@ -408,26 +620,74 @@ void Motor::motorFrame(unsigned char option, unsigned char type, unsigned char c
     }
 }
 
-void Motor::addRequestMeasure()
+void Motor::addRequestMeasure(bool measure, bool telemetry, const ros::Time &acquisition)
 {
-    // Set type of command
-    motor_command.bitset.command = MOTOR_MEASURE;
-    // Build a packet
-    packet_information_t frame_measure = CREATE_PACKET_RESPONSE(motor_command.command_message, HASHMAP_MOTOR, PACKET_REQUEST);
-    // Add packet in the frame
-    mSerial->addFrame(frame_measure)->addFrame(information_motor)->sendList();
+    if(measure)
+    {
+        measure_stamp = acquisition;
+        // Build a packet
+        packet_information_t frame_measure = orbus::request<HASHMAP_MOTOR, MOTOR_MEASURE>(mNumber);
+        // Add packet in the frame
+        mSerial->addFrame(frame_measure);
+    }
+    if(telemetry)
+    {
+        mSerial->addFrame(information_motor);
+    }
 }
 
 void Motor::resetPosition(double position)
 {
-    // Set type of command
-    motor_command.bitset.command = MOTOR_POS_RESET;
     // Build a packet
-    message_abstract_u temp;
-    temp.motor.reference = static_cast<motor_control_t>(position*1000.0);
-    packet_information_t frame = CREATE_PACKET_DATA(motor_command.command_message, HASHMAP_MOTOR, temp);
+    motor_control_t reference = static_cast<motor_control_t>(position*1000.0);
+    packet_information_t frame = orbus::encode<HASHMAP_MOTOR, MOTOR_POS_RESET>(mNumber, reference);
     // Add packet in the frame
     mSerial->addFrame(frame);
+    // Restart the estimator from the new position
+    estimator.reset(position);
+}
+
+safety_level_t Motor::safetyLevel() const
+{
+    return std::max(current_safety.level(), temperature_safety.level());
+}
+
+bool Motor::emergencyRequired() const
+{
+    return safety_reaction == SAFETY_REACTION_ESTOP && safetyLevel() == SAFETY_CRITICAL;
+}
+
+double Motor::emergencyTimeout() const
+{
+    return emergency->timeout() / 1000.0;
+}
+
+void Motor::safetyEvent(const char *name, safety_level_t level, double value)
+{
+    // Logged only on a change, not checked
+    orbus::allocation::pause unchecked;
+    // Only on a change of level
+    switch(level)
+    {
+    case SAFETY_CRITICAL:
+        ROS_ERROR_STREAM("Motor [" << mMotorName << "] " << name << " critical: " << value
+                         << (safety_reaction == SAFETY_REACTION_DERATE ? " - derate command" : (safety_reaction == SAFETY_REACTION_ESTOP ? " - emergency stop" : "")));
+        break;
+    case SAFETY_WARNING:
+        ROS_WARN_STREAM("Motor [" << mMotorName << "] " << name << " over warning: " << value);
+        break;
+    case SAFETY_OK:
+        ROS_INFO_STREAM("Motor [" << mMotorName << "] " << name << " OK: " << value);
+        break;
+    }
+}
+
+void Motor::updateEstimate(const ros::Time& time)
+{
+    if(estimator_enable)
+    {
+        estimator.predict(time, position, velocity);
+    }
 }
 
 motor_state_t Motor::get_state(string type)
@@ -445,19 +705,20 @@ motor_state_t Motor::get_state(string type)
     return state;
 }
 
-void Motor::switchController(string type)
+packet_information_t Motor::stateFrame(motor_state_t state) const
 {
-    // Update the new state
-    mState = get_state(type);
-
-    // Set type of command
-    motor_command.bitset.command = MOTOR_STATE;
     // Build a packet
-    message_abstract_u temp;
-    temp.motor.state = mState;
-    packet_information_t frame = CREATE_PACKET_DATA(motor_command.command_message, HASHMAP_MOTOR, temp);
-    // Add packet in the frame
-    mSerial->addFrame(frame);
+    return orbus::encode<HASHMAP_MOTOR, MOTOR_STATE>(mNumber, state);
+}
+
+void Motor::setState(motor_state_t state)
+{
+    if(state != mState)
+    {
+        // The first reference in the new state is always sent
+        command_valid = false;
+    }
+    mState = state;
 }
 
 void Motor::writeCommandsToHardware(ros::Duration period)
@@ -468,37 +729,58 @@ void Motor::writeCommandsToHardware(ros::Duration period)
         // Enforce joint limits for all registered handles
         // Note: one can also enforce limits on a per-handle basis: handle.enforceLimits(period)
         vel_limits_interface.enforceLimits(period);
-        // Set type of command
-        motor_command.bitset.command = MOTOR_VEL_REF;
         break;
     case STATE_CONTROL_CURRENT:
-        // Set type of command
-        motor_command.bitset.command = MOTOR_CURRENT_REF;
         break;
     case STATE_CONTROL_DISABLE:
         // Does not send any command
         return;
     }
 
-    long long int reference_long = static_cast<long long int>(command*1000.0);
+    double value = command;
+    // Derate the command on a critical level
+    if(safety_reaction == SAFETY_REACTION_DERATE && safetyLevel() == SAFETY_CRITICAL)
+    {
+        value *= safety_derate;
+    }
+    long long int reference_long = static_cast<long long int>(value*1000.0);
     motor_control_t reference;
     // >>>>> Saturation on 32 bit values
     if(reference_long > MOTOR_CONTROL_MAX) {
         reference = MOTOR_CONTROL_MAX;
     } else if (reference_long < MOTOR_CONTROL_MIN) {
-        reference_long = MOTOR_CONTROL_MIN;
+        reference = MOTOR_CONTROL_MIN;
     } else {
         reference = (motor_control_t) reference_long;
     }
     // <<<<< Saturation on 32 bit values
 
+    if(command_dedup)
+    {
+        // Keepalive before the emergency timeout of the board, with margin
+        double keepalive = std::min(command_keepalive, emergency->timeout() / 2000.0);
+        ros::Time now = ros::Time::now();
+        if(command_valid && reference == last_reference && (now - last_sent).toSec() < keepalive)
+        {
+            commands_suppressed++;
+            return;
+        }
+        last_reference = reference;
+        last_sent = now;
+        command_valid = true;
+    }
+    commands_sent++;
+
     //ROS_INFO_STREAM("Vel[" << mNumber << "]:" << velocity);
     // Build a packet
-    message_abstract_u temp;
-    temp.motor.reference = reference;
-    packet_information_t frame = CREATE_PACKET_DATA(motor_command.command_message, HASHMAP_MOTOR, temp);
-    // Add packet in the frame
-    mSerial->addFrame(frame);
+    if(mState == STATE_CONTROL_CURRENT)
+    {
+        mSerial->addFrame(orbus::encode<HASHMAP_MOTOR, MOTOR_CURRENT_REF>(mNumber, reference));
+    }
+    else
+    {
+        mSerial->addFrame(orbus::encode<HASHMAP_MOTOR, MOTOR_VEL_REF>(mNumber, reference));
+    }
 
 }
 
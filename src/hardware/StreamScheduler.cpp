@@ -0,0 +1,97 @@
+#include "hardware/StreamScheduler.h"
+
+namespace ORInterface
+{
+
+StreamScheduler::StreamScheduler()
+    : mTick(0)
+    , mThrottle(1)
+{
+    // Commands and measures on each cycle, telemetry at lower rate
+    mDivisor[STREAM_COMMAND] = 1;
+    mDivisor[STREAM_MEASURE] = 1;
+    mDivisor[STREAM_TELEMETRY] = 10;
+    mDivisor[STREAM_GPIO] = 20;
+    mDivisor[STREAM_SYSTEM] = 10;
+    for(unsigned i = 0; i < STREAM_SIZE; ++i)
+    {
+        mPhase[i] = 0;
+        mScale[i] = 1;
+    }
+}
+
+const char *StreamScheduler::name(stream_t stream)
+{
+    switch(stream)
+    {
+    case STREAM_COMMAND:
+        return "command";
+    case STREAM_MEASURE:
+        return "measure";
+    case STREAM_TELEMETRY:
+        return "telemetry";
+    case STREAM_GPIO:
+        return "gpio";
+    case STREAM_SYSTEM:
+        return "system";
+    default:
+        return "unknown";
+    }
+}
+
+void StreamScheduler::setup(const ros::NodeHandle &nh)
+{
+    unsigned int offset = 0;
+    for(unsigned i = 0; i < STREAM_SIZE; ++i)
+    {
+        stream_t stream = (stream_t) i;
+        int divisor = mDivisor[i];
+        nh.param<int>(std::string("scheduler/") + name(stream) + "_divisor", divisor, divisor);
+        if(divisor < 1)
+        {
+            ROS_WARN_STREAM("Divisor of " << name(stream) << " must be at least 1");
+            divisor = 1;
+        }
+        mDivisor[i] = divisor;
+        // Each slow stream starts on a different cycle
+        mPhase[i] = (divisor > 1 ? (++offset) % divisor : 0);
+        ROS_DEBUG_STREAM("Stream " << name(stream) << " 1:" << mDivisor[i] << " phase " << mPhase[i]);
+    }
+}
+
+void StreamScheduler::tick()
+{
+    mTick++;
+}
+
+bool StreamScheduler::due(stream_t stream, unsigned int index) const
+{
+    return ((mTick + mPhase[stream] + index) % period(stream)) == 0;
+}
+
+unsigned int StreamScheduler::period(stream_t stream) const
+{
+    unsigned int period = mDivisor[stream] * mScale[stream];
+    if(stream == STREAM_TELEMETRY || stream == STREAM_GPIO)
+    {
+        period *= mThrottle;
+    }
+    return period;
+}
+
+unsigned int StreamScheduler::divisor(stream_t stream) const
+{
+    return period(stream);
+}
+
+void StreamScheduler::setScale(stream_t stream, unsigned int scale)
+{
+    mScale[stream] = (scale > 0 ? scale : 1);
+}
+
+void StreamScheduler::setThrottle(unsigned int throttle)
+{
+    mThrottle = (throttle > 0 ? throttle : 1);
+}
+
+}
@@ -0,0 +1,171 @@
+#include "hardware/allocation_check.h"
+
+#ifdef ALLOCATION_CHECK
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <new>
+
+// Original allocators from glibc
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t nmemb, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void *__libc_valloc(size_t size);
+
+static thread_local bool armed = false;
+static thread_local unsigned long counter = 0;
+
+/**
+ * Count an allocation, with ALLOCATION_CHECK_ABORT stop on the first one
+ */
+static inline void allocation()
+{
+    if(!armed)
+    {
+        return;
+    }
+    counter++;
+#ifdef ALLOCATION_CHECK_ABORT
+    armed = false;
+    static const char message[] = "Heap allocation in the control loop\n";
+    ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+    (void) written;
+    abort();
+#endif
+}
+
+extern "C" void *malloc(size_t size)
+{
+    allocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size)
+{
+    allocation();
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocation();
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size)
+{
+    allocation();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size)
+{
+    allocation();
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    allocation();
+    // Power of two and multiple of a pointer
+    if(alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    void *ptr = __libc_memalign(alignment, size);
+    if(ptr == NULL)
+    {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+
+extern "C" void *valloc(size_t size)
+{
+    allocation();
+    return __libc_valloc(size);
+}
+
+// The operators use the malloc above, also if the C++ library does not
+void *operator new(size_t size)
+{
+    void *ptr = malloc(size > 0 ? size : 1);
+    if(ptr == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+namespace orbus
+{
+namespace allocation
+{
+
+void arm()
+{
+    counter = 0;
+    armed = true;
+}
+
+unsigned long disarm()
+{
+    armed = false;
+    return counter;
+}
+
+pause::pause()
+    : mArmed(armed)
+{
+    armed = false;
+}
+
+pause::~pause()
+{
+    armed = mArmed;
+}
+
+}
+}
+
+#endif
@@ -3,6 +3,41 @@
 namespace orbus
 {
 
+/**
+ * @brief The receive_scope struct Buffer of the frames received, reused on
+ * each thread. A transaction nested in a callback uses a new buffer, the
+ * buffer of the outer transaction is still dispatched
+ */
+struct receive_scope
+{
+    receive_scope()
+        : received(depth() == 0 ? buffer() : nested)
+    {
+        depth()++;
+        received.clear();
+    }
+
+    ~receive_scope()
+    {
+        depth()--;
+    }
+
+    static vector<packet_information_t> &buffer()
+    {
+        static thread_local vector<packet_information_t> frames;
+        return frames;
+    }
+
+    static unsigned int &depth()
+    {
+        static thread_local unsigned int level = 0;
+        return level;
+    }
+
+    vector<packet_information_t> nested;
+    vector<packet_information_t> &received;
+};
+
 serial_controller::serial_controller(string port, unsigned long baudrate)
     : mSerialPort(port)
     , mBaudrate(baudrate)
@@ -13,6 +48,27 @@ serial_controller::serial_controller(string port, unsigned long baudrate)
     mStatus = SERIAL_OK;
     // Default timeout
     mTimeout = 500;
+    mReadSlice = 5;
+    // No frames refused
+    mNack = 0;
+    // Turnaround not measured
+    mTurnaround = 0;
+    mFailures = 0;
+    mCopied = 0;
+    // After the first transactions the list does not grow anymore
+    list_send.reserve(64);
+    list_queued.reserve(64);
+    // Empty receive buffer
+    mRxHead = 0;
+    mRxSize = 0;
+    // No emergency packet
+    mEmergencySize = 0;
+    mEmergencyPending = 0;
+    mLatched = false;
+    mCancel = false;
+    mCancelled = false;
+    mDropped = false;
+    mWritten = false;
 }
 
 serial_controller::~serial_controller()
@@ -28,7 +84,7 @@ bool serial_controller::start()
         mSerial.open();
         mSerial.setBaudrate(mBaudrate);
 
-        serial::Timeout to = serial::Timeout::simpleTimeout(mTimeout);
+        serial::Timeout to = serial::Timeout::simpleTimeout(mReadSlice);
         mSerial.setTimeout(to);
     }
     catch (serial::IOException& e)
@@ -66,9 +122,10 @@ bool serial_controller::stop()
     // Stop the reader
     mStopping = true;
     // Clean all messages
-    list_send.clear();
+    resetList();
     // Close the serial port
     mSerial.close();
+    return true;
 }
 
 bool serial_controller::addCallback(const callback_data_packet_t &callback, unsigned char type)
@@ -84,20 +141,17 @@ bool serial_controller::addCallback(const callback_data_packet_t &callback, unsi
 
 }
 
-serial_controller* serial_controller::addFrame(vector<packet_information_t> packet)
+serial_controller* serial_controller::addFrame(const vector<packet_information_t> &packet)
 {
-    mMutex.lock();
-    list_send.reserve(list_send.size() + packet.size());
-    list_send.insert(list_send.end(), packet.begin(), packet.end());
-    mMutex.unlock();
+    lock_guard<mutex> lock(mQueueMutex);
+    list_queued.insert(list_queued.end(), packet.begin(), packet.end());
     return this;
 }
 
-serial_controller* serial_controller::addFrame(packet_information_t packet)
+serial_controller* serial_controller::addFrame(const packet_information_t &packet)
 {
-    mMutex.lock();
-    list_send.push_back(packet);
-    mMutex.unlock();
+    lock_guard<mutex> lock(mQueueMutex);
+    list_queued.push_back(packet);
     return this;
 }
 
@@ -105,57 +159,196 @@ void serial_controller::resetList()
 {
     mMutex.lock();
     list_send.clear();
+    mQueueMutex.lock();
+    list_queued.clear();
+    mQueueMutex.unlock();
     mMutex.unlock();
 }
 
 bool serial_controller::sendList()
 {
+    return transaction(NULL);
+}
+
+bool serial_controller::sendList(vector<frame_result_t> &results)
+{
+    return transaction(&results);
+}
+
+bool serial_controller::transaction(vector<frame_result_t> *results)
+{
+    receive_scope scope;
+    vector<packet_information_t> &received = scope.received;
     mMutex.lock();
-    bool state = sendSerialFrame(list_send);
-    if(state) {
-        list_send.clear();
+    // The frames queued during the last transaction go after the frames not sent
+    mQueueMutex.lock();
+    list_send.insert(list_send.end(), list_queued.begin(), list_queued.end());
+    list_queued.clear();
+    mQueueMutex.unlock();
+    mNack = 0;
+    size_t sent = 0;
+    bool state = sendSerialFrame(list_send.data(), list_send.size(), received, sent);
+    if(results != NULL)
+    {
+        matchReplies(list_send.data(), list_send.size(), received, *results);
     }
+    // The frames written are not sent again with the next transaction
+    list_send.erase(list_send.begin(), list_send.begin() + sent);
     mMutex.unlock();
+    // Run all callbacks outside the transport lock
+    dispatch(received);
     return state;
 }
 
+bool serial_controller::sendNow(const packet_information_t *frames, size_t size, vector<packet_information_t> &replies)
+{
+    // The replies are decoded in the buffer of the caller, also for a nested call
+    replies.clear();
+    // A batch split on more packets can be applied only in part
+    packet_t packet;
+    if(encoder(&packet, const_cast<packet_information_t*>(frames), size) < size)
+    {
+        ROS_ERROR_STREAM("Batch of " << size << " frames too large for one packet");
+        return false;
+    }
+    mMutex.lock();
+    mNack = 0;
+    size_t sent = 0;
+    bool state = sendSerialFrame(frames, size, replies, sent);
+    mMutex.unlock();
+    dispatch(replies);
+    return state;
+}
+
+bool serial_controller::setEmergency(const vector<packet_information_t> &frames)
+{
+    packet_t packet;
+    unsigned int n_packet = encoder(&packet, const_cast<packet_information_t*>(frames.data()), frames.size());
+    if(n_packet < frames.size())
+    {
+        ROS_ERROR_STREAM("Emergency stop too large for one packet");
+        return false;
+    }
+    lock_guard<mutex> lock(mWriteMutex);
+    build_pkg(BufferEmergency, packet);
+    mEmergencySize = LNG_PACKET_HEADER + packet.length + 1;
+    return true;
+}
+
+bool serial_controller::emergency()
+{
+    lock_guard<mutex> lock(mWriteMutex);
+    if(mEmergencySize == 0 || !mSerial.isOpen())
+    {
+        return false;
+    }
+    size_t written = 0;
+    try
+    {
+        written = mSerial.write(BufferEmergency, mEmergencySize);
+    }
+    catch (serial::SerialException& e)
+    {
+        ROS_ERROR_STREAM("Unable to write emergency on serial port " << mSerialPort << " - Error: "  << e.what() );
+        return false;
+    }
+    catch (serial::IOException& e)
+    {
+        ROS_ERROR_STREAM("Unable to write emergency on serial port " << mSerialPort << " - Error: "  << e.what() );
+        return false;
+    }
+    if(written > 0)
+    {
+        // The board replies after the transaction in progress
+        mEmergencyPending++;
+        // Wake the reader, the reply of the transaction in progress is discarded
+        mCancel = true;
+    }
+    // Also if not written, the next packets do not drive the motors
+    mLatched = true;
+    return written == mEmergencySize;
+}
+
+void serial_controller::releaseEmergency()
+{
+    mLatched = false;
+}
+
 serial_status_t serial_controller::getStatus()
 {
     return mStatus;
 }
 
+unsigned int serial_controller::getNack()
+{
+    return mNack;
+}
+
+unsigned long serial_controller::getBaudrate()
+{
+    return mBaudrate;
+}
+
+double serial_controller::getTurnaround()
+{
+    return mTurnaround;
+}
+
+unsigned long serial_controller::getFailures()
+{
+    return mFailures;
+}
+
+unsigned long serial_controller::getCopied()
+{
+    return mCopied;
+}
+
 bool serial_controller::isAlive()
 {
+    vector<packet_information_t> received;
+    mMutex.lock();
     mSerial.flush();
-    return sendSerialFrame(CREATE_PACKET_RESPONSE(0, 0, PACKET_REQUEST));
+    mRxHead = mRxSize = 0;
+    mEmergencyPending = 0;
+    bool state = sendSerialFrame(CREATE_PACKET_RESPONSE(0, 0, PACKET_REQUEST), received);
+    mMutex.unlock();
+    dispatch(received);
+    return state;
 }
 
-bool serial_controller::sendSerialFrame(packet_information_t frame)
+bool serial_controller::sendSerialFrame(const packet_information_t &frame, vector<packet_information_t> &received)
 {
     packet_t packet = encoderSingle(frame);
     // Send the packet in serial and wait the received data
-    packet_t receive = sendSerialPacket(packet);
-    return parse_packet(receive);
+    if(!sendSerialPacket(packet))
+    {
+        if(!mCancelled)
+        {
+            mStatus = SERIAL_EMPTY;
+        }
+        return false;
+    }
+    return mDropped || parse_packet(mReceive, received);
 }
 
-bool serial_controller::parse_packet(packet_t receive)
+bool serial_controller::parse_packet(const packet_t &receive, vector<packet_information_t> &received)
 {
     if(receive.length > 0)
     {
-        // Read all frame and if is true send a packet with all new information
+        // Only the bytes of each frame, the slot is aligned for the callbacks
         for (int i = 0; i < receive.length; i += receive.buffer[i]) {
-            packet_information_t info;
-            memcpy((unsigned char*) &info, &receive.buffer[i], receive.buffer[i]);
-            if(info.type == 0)
+            size_t length = receive.buffer[i];
+            if(length == 0 || length > sizeof(packet_information_t))
             {
-                ROS_DEBUG("Return alive message");
+                break;
             }
-            // Check if is available on the hashmap
-            else if (hashmap.find(info.type) != hashmap.end())
+            received.push_back(packet_information_t());
+            memcpy((unsigned char*) &received.back(), &receive.buffer[i], length);
+            mCopied += length;
+            if(received.back().option == PACKET_NACK)
             {
-                // Send the message
-                callback_data_packet_t callback = hashmap[info.type];
-                callback(info.option, info.type, info.command, info.message);
+                mNack++;
             }
         }
         mStatus = SERIAL_OK;
@@ -165,42 +358,166 @@ bool serial_controller::parse_packet(packet_t receive)
     return false;
 }
 
-bool serial_controller::sendSerialFrame(vector<packet_information_t> list_send)
+void serial_controller::dispatch(const vector<packet_information_t> &received)
 {
-    if(list_send.size())
+    // One callback at time, a nested dispatch on the same thread is allowed
+    lock_guard<recursive_mutex> lock(mDispatchMutex);
+    for(unsigned i = 0; i < received.size(); ++i)
     {
-        // Encode the list of frames
-        packet_t packet;
-        unsigned int n_packet = encoder(&packet, list_send.data(), list_send.size());
-        if(n_packet == list_send.size())
+        const packet_information_t &info = received[i];
+        if(info.type == 0)
         {
-            // Send the packet in serial and wait the received data
-            packet_t receive = sendSerialPacket(packet);
-            // Parse packet
-            return parse_packet(receive);
+            ROS_DEBUG("Return alive message");
+            continue;
+        }
+        // Check if is available on the hashmap
+        map<int, callback_data_packet_t>::iterator it = hashmap.find(info.type);
+        if(it != hashmap.end())
+        {
+            // Send the message
+            it->second(info.option, info.type, info.command, info.message);
+        }
+    }
+}
+
+void serial_controller::matchReplies(const packet_information_t *frames, size_t size, const vector<packet_information_t> &received, vector<frame_result_t> &results)
+{
+    results.resize(size);
+    for(size_t j = 0; j < size; ++j)
+    {
+        results[j].type = frames[j].type;
+        results[j].command = frames[j].command;
+        results[j].answer = FRAME_MISSING;
+    }
+    size_t first = 0;
+    for(unsigned i = 0; i < received.size(); ++i)
+    {
+        const packet_information_t *info = &received[i];
+        // The first frame not answered with the same type and command
+        for(size_t j = first; j < size; ++j)
+        {
+            if(results[j].answer == FRAME_MISSING && frames[j].type == info->type && frames[j].command == info->command)
+            {
+                results[j].answer = (info->option == PACKET_ACK ? FRAME_ACK : (info->option == PACKET_NACK ? FRAME_NACK : FRAME_DATA));
+                break;
+            }
+        }
+        while(first < size && results[first].answer != FRAME_MISSING)
+        {
+            first++;
+        }
+    }
+}
+
+bool serial_controller::sendSerialFrame(const packet_information_t *list_send, size_t size, vector<packet_information_t> &received, size_t &sent)
+{
+    // Split the list in the minimum number of full packets
+    sent = 0;
+    while(sent < size)
+    {
+        // Encode the list of frames in the transmission packet
+        unsigned int n_packet = encoder(&mTransmit, const_cast<packet_information_t*>(list_send + sent), size - sent);
+        if(n_packet == 0)
+        {
+            ROS_ERROR_STREAM("Buffer FULL");
+            mStatus = SERIAL_BUFFER_FULL;
+            return false;
+        }
+        // Send the packet in serial and wait the received data
+        bool answered = sendSerialPacket(mTransmit);
+        // Written also without answer, the board can have applied it
+        if(mWritten)
+        {
+            sent += n_packet;
+        }
+        if(!answered)
+        {
+            // After an emergency the link is still working
+            if(!mCancelled)
+            {
+                mStatus = SERIAL_EMPTY;
+            }
+            return false;
+        }
+        // Parse packet, nothing to parse if all frames are dropped
+        if(!mDropped && !parse_packet(mReceive, received))
+        {
+            return false;
         }
-        ROS_ERROR_STREAM("Buffer FULL");
-        mStatus = SERIAL_BUFFER_FULL;
     }
     return true;
 }
 
-packet_t serial_controller::sendSerialPacket(packet_t packet)
+bool serial_controller::sendSerialPacket(const packet_t &packet)
 {
+    mCancelled = false;
+    mDropped = false;
+    mWritten = false;
     if(mSerial.isOpen())
     {
-        writePacket(packet);
-        if(readPacket())
+        ros::WallTime start;
+        const packet_t *out = &packet;
+        {
+            // An emergency packet can not be written between the discard and this packet
+            unique_lock<mutex> lock(mWriteMutex);
+            // Only an emergency written from now wakes the reader
+            mCancel = false;
+            // Discard the replies of the emergency packets, an emergency can be written meanwhile
+            while(mEmergencyPending > 0)
+            {
+                mEmergencyPending--;
+                lock.unlock();
+                if(!readPacket(true))
+                {
+                    // A new emergency, this packet is not sent
+                    if(mCancelled)
+                    {
+                        return false;
+                    }
+                    mSerial.flushInput();
+                    mRxHead = mRxSize = 0;
+                    mEmergencyPending = 0;
+                }
+                lock.lock();
+            }
+            // After the emergency stop the motors are not driven, checked with the lock
+            if(mLatched && filterMotion(packet, mFiltered))
+            {
+                out = &mFiltered;
+                if(mFiltered.length == 0)
+                {
+                    ROS_DEBUG_STREAM("Emergency latched, packet dropped");
+                    mDropped = true;
+                    mWritten = true;
+                    return true;
+                }
+            }
+            start = ros::WallTime::now();
+            writePacket(*out);
+            // Also a partial packet can reach the board
+            mWritten = true;
+        }
+        // The reply is stored in mReceive
+        if(!readPacket(true))
         {
-            return mReceive;
+            if(!mCancelled)
+            {
+                mFailures++;
+            }
+            return false;
         }
+        // Remove the time on the wire, 10 bits for each byte
+        size_t bytes = (LNG_PACKET_HEADER + out->length + 1) + (LNG_PACKET_HEADER + mReceive.length + 1);
+        double turnaround = max((ros::WallTime::now() - start).toSec() - (bytes * 10.0) / mBaudrate, 0.0);
+        // Only the transaction writes the average, under mMutex
+        double average = mTurnaround.load();
+        mTurnaround.store(average > 0 ? 0.9 * average + 0.1 * turnaround : turnaround);
+        return true;
     }
-    packet_t empty;
-    empty.length = 0;
-    return empty;
+    return false;
 }
 
-bool serial_controller::writePacket(packet_t packet)
+bool serial_controller::writePacket(const packet_t &packet)
 {
     // Size of the packet
     int dataSize = (LNG_PACKET_HEADER + packet.length + 1);
@@ -208,6 +525,7 @@ bool serial_controller::writePacket(packet_t packet)
     ROS_DEBUG_STREAM( "To be written " << dataSize << " bytes" );
     //Build a message to send to serial
     build_pkg(BufferTx, packet);
+    mCopied += packet.length;
     // Send the packet on serial
     int written = 0;
     try
@@ -235,9 +553,56 @@ bool serial_controller::writePacket(packet_t packet)
     return true;
 }
 
-bool serial_controller::readPacket()
+bool serial_controller::filterMotion(const packet_t &packet, packet_t &filtered)
 {
+    filtered.length = 0;
+    for(int i = 0; i < packet.length && packet.buffer[i] > 0; i += packet.buffer[i])
+    {
+        const packet_information_t *frame = (const packet_information_t*) &packet.buffer[i];
+        if(!allowedLatched(*frame))
+        {
+            continue;
+        }
+        memcpy(&filtered.buffer[filtered.length], frame, frame->length);
+        filtered.length += frame->length;
+    }
+    return filtered.length != packet.length;
+}
+
+bool serial_controller::allowedLatched(const packet_information_t &frame)
+{
+    // Requests and frames of the other hashmaps (system, diagnostics) do not drive a motor
+    if(frame.option != PACKET_DATA || frame.type != HASHMAP_MOTOR)
+    {
+        return true;
+    }
+    motor_command_map_t command;
+    command.command_message = frame.command;
+    switch(command.bitset.command)
+    {
+    case MOTOR_STATE:
+        return frame.message.motor.state == STATE_CONTROL_DISABLE
+                || frame.message.motor.state == STATE_CONTROL_EMERGENCY;
+    default:
+        // References, position reset, PID, parameters and safety writes
+        return false;
+    }
+}
+
+bool serial_controller::readPacket(bool cancel)
+{
+    ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(mTimeout / 1000.0);
     do {
+        // Bytes left from the last read
+        while(mRxHead < mRxSize)
+        {
+            unsigned char data = BufferRx[mRxHead++];
+            if (decode_pkgs(data))
+            {
+                return true;
+            }
+        }
+        mRxHead = mRxSize = 0;
 
         if( mStopping )
         {
@@ -246,14 +611,26 @@ bool serial_controller::readPacket()
 
         if( !mSerial.waitReadable() )
         {
+            // The emergency is written, the board replies to both packets later
+            if( cancel && mCancel.exchange(false) )
+            {
+                ROS_WARN_STREAM("Transaction cancelled from the emergency stop");
+                mEmergencyPending++;
+                mCancelled = true;
+                return false;
+            }
+            if( ros::WallTime::now() < deadline )
+            {
+                continue;
+            }
             mStatus = SERIAL_TIMEOUT;
             ROS_ERROR_STREAM( "Serial timeout connecting");
             return false;
         }
-        string reply;
+        size_t size = 0;
         try
         {
-            reply = mSerial.read( mSerial.available() );
+            size = mSerial.read(BufferRx, min(mSerial.available(), sizeof(BufferRx)));
         }
         catch (serial::SerialException& e)
         {
@@ -268,16 +645,8 @@ bool serial_controller::readPacket()
             return false;
         }
 
-        ROS_DEBUG_STREAM( "Received " << reply.size() << " bytes" );
-
-        for (unsigned i=0; i<reply.length(); ++i)
-        {
-            unsigned char data = reply.at(i);
-            if (decode_pkgs(data))
-            {
-                return true;
-            }
-        }
+        ROS_DEBUG_STREAM( "Received " << size << " bytes" );
+        mRxSize = size;
     } while(true);
 }
 
@@ -1,25 +1,64 @@
 
 #include <string>
+#include <sstream>
+#include <set>
+#include <algorithm>
+#include <future>
 
 #include <hardware_interface/joint_state_interface.h>
 #include <hardware_interface/joint_command_interface.h>
 
 #include "hardware/uNavInterface.h"
+#include "hardware/allocation_check.h"
 
 namespace ORInterface
 {
 
-#define MAX_MOTORS 8
-
 uNavInterface::uNavInterface(const ros::NodeHandle &nh, const ros::NodeHandle &private_nh, orbus::serial_controller *serial)
     : GenericInterface(nh, private_nh, serial)
+    , mCache(NULL)
+    , mSwitchLatencyMax(0)
+    , mEmergency(false)
+    , mEmergencyLatencyMax(0)
+    , mLinkTelemetry(0)
+    , mLinkGpio(0)
+    , mCycleLatency(0)
+    , mCycleLatencyMax(0)
+    , mUpdateDelay(0)
+    , mFailures(0)
+    , mLinkLost(false)
+    , mSynced(false)
+    , mIdle(false)
+    , mEmergencySpinner(1, &mEmergencyQueue)
 {
+    // All configurators read the parameters from the snapshot of the namespace
+    mSnapshot = new ParamSnapshot(private_mNh);
+    GenericConfigurator::setSnapshot(mSnapshot);
+    // The configurations received from the board are written in background
+    mWriter = new ParamWriter();
+    GenericConfigurator::setWriter(mWriter);
+
+    // No motors available
+    for(unsigned i=0; i < MAX_MOTORS; ++i)
+    {
+        mMotor[i] = NULL;
+    }
     /// Added all callback to receive information about messages
     bool initCallback = mSerial->addCallback(&uNavInterface::allMotorsFrame, this, HASHMAP_MOTOR);
 
+    // The identity of the board is requested while the motors read the parameter server.
+    // All callbacks must be registered before, the serial controller does not lock them
+    ros::WallTime start_identity = ros::WallTime::now();
+    std::future<bool> identity = std::async(std::launch::async, &uNavInterface::requestIdentity, this);
+
     //Services
     srv_unav = private_mNh.advertiseService("board", &uNavInterface::service_Callback, this);
 
+    // A switch of all motors is one transaction
+    mSwitchFrames.reserve(MAX_MOTORS);
+    mSwitchReplies.reserve(MAX_MOTORS);
+    private_mNh.param<double>("switch_latency_limit", mSwitchLatencyLimit, 0.02);
+
    std::vector<std::string> joint_list;
    if(private_nh.hasParam("joint"))
    {
@@ -48,18 +87,124 @@ uNavInterface::uNavInterface(const ros::NodeHandle &nh, const ros::NodeHandle &p
             private_nh.setParam(motor_name + "/number", number);
         }
         // Check if the number is available in the unav protocol
-        if(number < MAX_MOTORS)
+        if(number < 0 || number >= MAX_MOTORS)
         {
-            ROS_INFO_STREAM("Motor[" << number << "] name: " << motor_name);
-            mMotor[motor_name] = new Motor(private_mNh, serial, motor_name, number);
-            mMotorName[number] = motor_name;
+            ROS_ERROR_STREAM("Motor: " << motor_name <<  ". Is to high with maximum motors available " << number << " > " << MAX_MOTORS);
+        }
+        else if(mMotor[number] != NULL)
+        {
+            ROS_ERROR_STREAM("Motor: " << motor_name <<  ". Number " << number << " already used");
         }
         else
         {
-            ROS_ERROR_STREAM("Motor: " << motor_name <<  ". Is to high with maximum motors available " << number << " > " << MAX_MOTORS);
+            ROS_INFO_STREAM("Motor[" << number << "] name: " << motor_name);
+            mMotor[number] = new Motor(private_mNh, serial, &mTable, motor_name, number);
+            mMotorNumber[motor_name] = number;
+            mJoints.push_back(number);
+        }
+    }
+
+    ROS_INFO_STREAM("STARTUP - Motors configured in " << (ros::WallTime::now() - start_identity).toSec() << "s");
+    // The name of the board is required from the cache
+    identity.get();
+    ROS_INFO_STREAM("STARTUP - Board identity and motors ready in " << (ros::WallTime::now() - start_identity).toSec() << "s");
+
+    // Emergency stop of all motors, built once and sent without the queue
+    string emergency_mode;
+    private_nh.param<string>("emergency_mode", emergency_mode, "emergency");
+    motor_state_t emergency_state = (emergency_mode == "disable" ? STATE_CONTROL_DISABLE : STATE_CONTROL_EMERGENCY);
+    vector<packet_information_t> emergency_frames;
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        emergency_frames.push_back(mMotor[mJoints[i]]->stateFrame(emergency_state));
+    }
+    mSerial->setEmergency(emergency_frames);
+    // The emergency stop does not wait the callbacks of the controller manager
+    ros::NodeHandle emergency_nh(private_mNh);
+    emergency_nh.setCallbackQueue(&mEmergencyQueue);
+    srv_emergency = emergency_nh.advertiseService("emergency_stop", &uNavInterface::emergency_Callback, this);
+    sub_emergency = emergency_nh.subscribe("emergency_stop", 1, &uNavInterface::emergency_subscriber_Callback, this, ros::TransportHints().tcpNoDelay());
+    mEmergencySpinner.start();
+
+    // Budget of the serial link at the rate of the control loop
+    double control_frequency;
+    private_nh.param<double>("control_frequency", control_frequency, 1.0);
+    mLinkBudget.setup(private_mNh, mSerial->getBaudrate(), control_frequency);
+    // Adapt the rate of the control loop to the link
+    mRate.setup(private_mNh, control_frequency);
+    if(mRate.enabled())
+    {
+        pub_rate = private_mNh.advertise<orbus_interface::ControlRate>("control_rate", 1, true);
+    }
+    // Without controllers the measures are polled at low rate
+    int idle_divisor;
+    private_nh.param<int>("idle_mode/divisor", idle_divisor, 10);
+    mIdleDivisor = std::max(idle_divisor, 1);
+    updateIdle();
+
+    // Aggregated measures of the board, all arrays allocated once
+    private_nh.param<bool>("aggregate_telemetry", mAggregate, false);
+    if(mAggregate)
+    {
+        pub_telemetry = private_mNh.advertise<orbus_interface::JointTelemetry>("telemetry", 10);
+        gate_telemetry.setup(private_mNh, "publish/telemetry");
+        size_t joints = mJoints.size();
+        msg_telemetry.name.resize(joints);
+        msg_telemetry.pwm.resize(joints);
+        msg_telemetry.position.resize(joints);
+        msg_telemetry.velocity.resize(joints);
+        msg_telemetry.current.resize(joints);
+        msg_telemetry.effort.resize(joints);
+        for(map<string, unsigned int>::iterator it = mMotorNumber.begin(); it != mMotorNumber.end(); ++it)
+        {
+            size_t index = std::find(mJoints.begin(), mJoints.end(), it->second) - mJoints.begin();
+            msg_telemetry.name[index] = it->first;
         }
     }
 
+    // Load the cache of the configuration, if enabled only the changes are sent
+    string cache_path, cache_id;
+    private_nh.param<string>("config_cache", cache_path, "");
+    // Identifier of the unit, e.g. the serial number of the adapter, to split the same boards
+    private_nh.param<string>("config_cache_id", cache_id, "");
+    if(!cache_path.empty())
+    {
+        string identity = code_board_type + "/" + code_board_name + "/" + code_version + "/" + code_date;
+        if(!cache_id.empty())
+        {
+            identity += "/" + cache_id;
+        }
+        mCache = new ConfigCache(cache_path, identity);
+        mCache->load();
+        GenericConfigurator::setCache(mCache);
+    }
+
+}
+
+uNavInterface::~uNavInterface()
+{
+    // No emergency callback runs on the objects released below
+    mEmergencySpinner.stop();
+    srv_emergency.shutdown();
+    sub_emergency.shutdown();
+    // The callbacks of the other threads read the shared objects, all swaps under their lock
+    std::unique_lock<std::recursive_mutex> lock(mSerial->dispatchMutex());
+    GenericConfigurator::setWriter(NULL);
+    lock.unlock();
+    // The worker writes on the configurators of the motors, stop it while they are alive
+    delete mWriter;
+    lock.lock();
+    for(unsigned i = 0; i < MAX_MOTORS; ++i)
+    {
+        // The timers of the configurators are stopped with the motor
+        delete mMotor[i];
+        mMotor[i] = NULL;
+    }
+    GenericConfigurator::setCache(NULL);
+    GenericConfigurator::setSnapshot(NULL);
+    lock.unlock();
+    delete mCache;
+    delete mSnapshot;
 }
 
 bool uNavInterface::service_Callback(orbus_interface::Service::Request &req, orbus_interface::Service::Response &msg)
@@ -73,35 +218,364 @@ bool uNavInterface::service_Callback(orbus_interface::Service::Request &req, orb
     return true;
 }
 
+bool uNavInterface::emergency_Callback(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res)
+{
+    return emergencyStop();
+}
+
+void uNavInterface::emergency_subscriber_Callback(const std_msgs::Bool::ConstPtr& msg)
+{
+    if(msg->data)
+    {
+        emergencyStop();
+    }
+    else
+    {
+        releaseEmergency();
+    }
+}
+
+bool uNavInterface::emergencyStop()
+{
+    // The control loop stops to send commands from the next cycle
+    mEmergency = true;
+    ros::WallTime start = ros::WallTime::now();
+    bool written = mSerial->emergency();
+    double latency = (ros::WallTime::now() - start).toSec();
+    // Stops from the emergency thread and the control loop race on the maximum
+    double latency_max = mEmergencyLatencyMax.load();
+    while(latency > latency_max && !mEmergencyLatencyMax.compare_exchange_weak(latency_max, latency))
+    {
+    }
+    if(written)
+    {
+        ROS_ERROR_STREAM("EMERGENCY STOP - written in " << latency * 1000000.0 << "us - max " << std::max(latency, latency_max) * 1000000.0 << "us");
+    }
+    else
+    {
+        ROS_ERROR_STREAM("EMERGENCY STOP - unable to write on the serial port");
+    }
+    return written;
+}
+
+void uNavInterface::releaseEmergency()
+{
+    if(mEmergency)
+    {
+        mEmergency = false;
+        // The motors are disabled on the host, the transport can send the references again
+        mSerial->releaseEmergency();
+        ROS_WARN_STREAM("Emergency released, restart the controllers to drive the motors");
+    }
+}
+
+bool uNavInterface::planLink()
+{
+    typedef orbus::frame_descriptor<HASHMAP_MOTOR, MOTOR_VEL_REF> command_t;
+    typedef orbus::frame_descriptor<HASHMAP_MOTOR, MOTOR_MEASURE> measure_t;
+    typedef orbus::frame_descriptor<HASHMAP_MOTOR, MOTOR_REFERENCE> telemetry_t;
+    typedef orbus::frame_descriptor<HASHMAP_PERIPHERALS, PERIPHERALS_GPIO_DIGITAL> gpio_t;
+    typedef orbus::frame_descriptor<HASHMAP_SYSTEM, SYSTEM_TIME> system_t;
+    size_t motors = mJoints.size();
+    mLinkTelemetry = 0;
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        mLinkTelemetry += mMotor[mJoints[i]]->telemetryFrames();
+    }
+    mLinkGpio = information_frames.size();
+    // A reference is acknowledged, a request is answered with the data
+    mLinkBudget.setStream(STREAM_COMMAND, motors * (ORBUS_FRAME_HEADER + command_t::size), motors * ORBUS_FRAME_HEADER,
+                          mScheduler.divisor(STREAM_COMMAND));
+    mLinkBudget.setStream(STREAM_MEASURE, motors * ORBUS_FRAME_HEADER, motors * (ORBUS_FRAME_HEADER + measure_t::size),
+                          mScheduler.divisor(STREAM_MEASURE));
+    mLinkBudget.setStream(STREAM_TELEMETRY, mLinkTelemetry * ORBUS_FRAME_HEADER, mLinkTelemetry * (ORBUS_FRAME_HEADER + telemetry_t::size),
+                          mScheduler.divisor(STREAM_TELEMETRY));
+    mLinkBudget.setStream(STREAM_GPIO, mLinkGpio * ORBUS_FRAME_HEADER, mLinkGpio * (ORBUS_FRAME_HEADER + gpio_t::size),
+                          mScheduler.divisor(STREAM_GPIO));
+    mLinkBudget.setStream(STREAM_SYSTEM, ORBUS_FRAME_HEADER, ORBUS_FRAME_HEADER + system_t::size,
+                          mScheduler.divisor(STREAM_SYSTEM));
+
+    link_status_t status = mLinkBudget.plan(mSerial->getTurnaround());
+    std::stringstream budget;
+    budget << mLinkBudget.bytesPerCycle() << " bytes/cycle at " << mSerial->getBaudrate() << " baud - "
+           << mLinkBudget.utilization() * 100.0 << "% of the link - max rate " << mLinkBudget.maxRate() << "Hz";
+    switch(status)
+    {
+    case LINK_OVERLOAD:
+        ROS_ERROR_STREAM("LINK - Overload " << budget.str() << ". Reduce control_frequency or the rate of the streams");
+        return !mLinkBudget.refuse();
+    case LINK_WARNING:
+        ROS_WARN_STREAM("LINK - " << budget.str());
+        break;
+    default:
+        ROS_INFO_STREAM("LINK - " << budget.str());
+        break;
+    }
+    return true;
+}
+
+void uNavInterface::run(diagnostic_updater::DiagnosticStatusWrapper &stat)
+{
+    GenericInterface::run(stat);
+
+    // Same streams, with the last turnaround measured
+    mLinkBudget.plan(mSerial->getTurnaround());
+    stat.add("Link bytes/cycle", mLinkBudget.bytesPerCycle());
+    stat.add("Link utilization (%)", mLinkBudget.utilization() * 100.0);
+    stat.add("Link max rate (Hz)", mLinkBudget.maxRate());
+    stat.add("Turnaround (uS)", mLinkBudget.turnaround() * 1000000.0);
+    switch(mLinkBudget.status())
+    {
+    case LINK_OVERLOAD:
+        stat.mergeSummaryf(diagnostic_msgs::DiagnosticStatus::ERROR, "Link overload %5.1f%%", mLinkBudget.utilization() * 100.0);
+        break;
+    case LINK_WARNING:
+        stat.mergeSummaryf(diagnostic_msgs::DiagnosticStatus::WARN, "Link utilization %5.1f%%", mLinkBudget.utilization() * 100.0);
+        break;
+    default:
+        break;
+    }
+}
+
+bool uNavInterface::updateRate(bool connected)
+{
+    unsigned long failures = mSerial->getFailures();
+    // The timeout can change from the dynamic reconfigure
+    bool changed = limitRate();
+    if(connected)
+    {
+        changed |= mRate.update(mCycleLatencyMax, failures - mFailures, boardIdle());
+    }
+    else
+    {
+        changed |= mRate.lost();
+    }
+    mLinkLost = !connected;
+    mFailures = failures;
+    mCycleLatencyMax = 0;
+    if(!changed)
+    {
+        return false;
+    }
+    // The telemetry follows the level, the divisors in the configuration are not changed
+    mScheduler.setScale(STREAM_TELEMETRY, mRate.telemetryScale());
+    mScheduler.setScale(STREAM_GPIO, mRate.telemetryScale());
+    mLinkBudget.setFrequency(mRate.frequency());
+    // Event for the controllers
+    msg_rate.header.stamp = ros::Time::now();
+    msg_rate.frequency = mRate.frequency();
+    msg_rate.nominal = mRate.nominal();
+    msg_rate.telemetry_scale = mRate.telemetryScale();
+    msg_rate.level = mRate.level();
+    msg_rate.reason = mRate.reason();
+    pub_rate.publish(msg_rate);
+    ROS_WARN_STREAM("RATE - " << mRate.reason() << ": control " << mRate.frequency() << "Hz - telemetry 1:" << mScheduler.divisor(STREAM_TELEMETRY) << " - level " << mRate.level());
+    planLink();
+    return true;
+}
+
+bool uNavInterface::limitRate()
+{
+    double timeout = 0;
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        double motor = mMotor[mJoints[i]]->emergencyTimeout();
+        if(motor > 0 && (timeout == 0 || motor < timeout))
+        {
+            timeout = motor;
+        }
+    }
+    if(timeout <= 0)
+    {
+        return false;
+    }
+    // The commands are sent only on a part of the cycles
+    double minimum = 2.0 * mScheduler.divisor(STREAM_COMMAND) / timeout;
+    if(!mRate.limit(minimum))
+    {
+        return false;
+    }
+    if(minimum > mRate.nominal())
+    {
+        ROS_WARN_STREAM("RATE - control " << mRate.nominal() << "Hz sends less than two commands in the emergency timeout of " << timeout * 1000.0 << "ms");
+    }
+    else if(mRate.enabled() && mRate.minimum() == minimum)
+    {
+        ROS_WARN_STREAM("RATE - minimum frequency raised to " << minimum << "Hz, two commands in the emergency timeout of " << timeout * 1000.0 << "ms");
+    }
+    return true;
+}
+
+void uNavInterface::updateIdle()
+{
+    bool idle = true;
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        if(mTable.state[mJoints[i]] != STATE_CONTROL_DISABLE)
+        {
+            idle = false;
+            break;
+        }
+    }
+    if(idle == mIdle)
+    {
+        return;
+    }
+    mIdle = idle;
+    mScheduler.setScale(STREAM_MEASURE, mIdle ? mIdleDivisor : 1);
+    ROS_INFO_STREAM("IDLE - " << (mIdle ? "No controllers running" : "Controllers running") << ", measures 1:" << mScheduler.divisor(STREAM_MEASURE));
+}
+
 bool uNavInterface::prepareSwitch(const std::list<hardware_interface::ControllerInfo>& start_list, const std::list<hardware_interface::ControllerInfo>& stop_list)
 {
     ROS_INFO_STREAM("Prepare to switch!");
+    if(!start_list.empty() && mEmergency)
+    {
+        ROS_ERROR_STREAM("Switch refused, emergency stop active");
+        return false;
+    }
+    // The new states are sent to the board in doSwitch, without the board the switch fails
+    if(!start_list.empty() && mSerial->getStatus() != orbus::SERIAL_OK)
+    {
+        ROS_ERROR_STREAM("Switch refused, the board is not connected");
+        return false;
+    }
+    // All joints are available and each joint is started from only one controller
+    std::set<std::string> started;
+    for(std::list<hardware_interface::ControllerInfo>::const_iterator it = start_list.begin(); it != start_list.end(); ++it)
+    {
+        for(std::vector<hardware_interface::InterfaceResources>::const_iterator iface_it = it->claimed_resources.begin(); iface_it != it->claimed_resources.end(); ++iface_it)
+        {
+            for (std::set<std::string>::const_iterator res_it = iface_it->resources.begin(); res_it != iface_it->resources.end(); ++res_it)
+            {
+                if(mMotorNumber.find(*res_it) == mMotorNumber.end())
+                {
+                    ROS_ERROR_STREAM("Switch refused, " << it->name << " claims the unknown joint " << *res_it);
+                    return false;
+                }
+                if(!started.insert(*res_it).second)
+                {
+                    ROS_ERROR_STREAM("Switch refused, " << *res_it << " is claimed from more controllers");
+                    return false;
+                }
+            }
+        }
+    }
     return true;
 }
 
 void uNavInterface::doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list, const std::list<hardware_interface::ControllerInfo>& stop_list)
 {
+    // New state of each motor, the motors not in the lists are not changed
+    motor_state_t target[MAX_MOTORS];
+    bool changed[MAX_MOTORS] = { false };
     // Stop all controller in list
     for(std::list<hardware_interface::ControllerInfo>::const_iterator it = stop_list.begin(); it != stop_list.end(); ++it)
     {
-        //ROS_INFO_STREAM("DO SWITCH STOP name: " << it->name << " - type: " << it->type);
-        const hardware_interface::InterfaceResources& iface_res = it->claimed_resources.front();
-        for (std::set<std::string>::const_iterator res_it = iface_res.resources.begin(); res_it != iface_res.resources.end(); ++res_it)
+        for(std::vector<hardware_interface::InterfaceResources>::const_iterator iface_it = it->claimed_resources.begin(); iface_it != it->claimed_resources.end(); ++iface_it)
         {
-            ROS_INFO_STREAM(it->name << "[" << *res_it << "] STOP");
-            mMotor[*res_it]->switchController("disable");
+            for (std::set<std::string>::const_iterator res_it = iface_it->resources.begin(); res_it != iface_it->resources.end(); ++res_it)
+            {
+                ROS_INFO_STREAM(it->name << "[" << *res_it << "] STOP");
+                map<string, unsigned int>::iterator number = mMotorNumber.find(*res_it);
+                if(number != mMotorNumber.end())
+                {
+                    target[number->second] = STATE_CONTROL_DISABLE;
+                    changed[number->second] = true;
+                }
+            }
         }
     }
     // Run all new controllers
     for(std::list<hardware_interface::ControllerInfo>::const_iterator it = start_list.begin(); it != start_list.end(); ++it)
     {
-        //ROS_INFO_STREAM("DO SWITCH START name: " << it->name << " - type: " << it->type);
-        const hardware_interface::InterfaceResources& iface_res = it->claimed_resources.front();
-        for (std::set<std::string>::const_iterator res_it = iface_res.resources.begin(); res_it != iface_res.resources.end(); ++res_it)
+        for(std::vector<hardware_interface::InterfaceResources>::const_iterator iface_it = it->claimed_resources.begin(); iface_it != it->claimed_resources.end(); ++iface_it)
+        {
+            for (std::set<std::string>::const_iterator res_it = iface_it->resources.begin(); res_it != iface_it->resources.end(); ++res_it)
+            {
+                ROS_INFO_STREAM(it->name << "[" << *res_it << "] START");
+                map<string, unsigned int>::iterator number = mMotorNumber.find(*res_it);
+                if(number != mMotorNumber.end())
+                {
+                    target[number->second] = Motor::get_state(it->type);
+                    changed[number->second] = true;
+                }
+            }
+        }
+    }
+    // All new states in one batch, sent before the next references
+    mSwitchFrames.clear();
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        if(changed[mJoints[i]])
+        {
+            mSwitchFrames.push_back(mMotor[mJoints[i]]->stateFrame(target[mJoints[i]]));
+        }
+    }
+    if(mSwitchFrames.empty())
+    {
+        updateIdle();
+        return;
+    }
+    ros::WallTime start = ros::WallTime::now();
+    mSerial->sendNow(mSwitchFrames.data(), mSwitchFrames.size(), mSwitchReplies);
+    double latency = (ros::WallTime::now() - start).toSec();
+    // Check the answer of the board for each motor
+    bool acked[MAX_MOTORS] = { false };
+    for(unsigned i=0; i < mSwitchReplies.size(); ++i)
+    {
+        const packet_information_t &reply = mSwitchReplies[i];
+        motor_command_map_t motor;
+        motor.command_message = reply.command;
+        if(reply.type == HASHMAP_MOTOR && motor.bitset.command == MOTOR_STATE && motor.bitset.motor < MAX_MOTORS)
+        {
+            acked[motor.bitset.motor] = (reply.option == PACKET_ACK);
+        }
+    }
+    std::stringstream refused;
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        if(changed[mJoints[i]] && !acked[mJoints[i]])
+        {
+            refused << " " << mJoints[i];
+        }
+    }
+    if(refused.str().empty())
+    {
+        for(unsigned i=0; i < mJoints.size(); ++i)
+        {
+            if(changed[mJoints[i]])
+            {
+                mMotor[mJoints[i]]->setState(target[mJoints[i]]);
+            }
+        }
+    }
+    else
+    {
+        // The switch is all or nothing, the motors already switched are disabled again
+        ROS_ERROR_STREAM("Switch not confirmed from the board for motors [" << refused.str() << " ], all motors of the switch disabled");
+        mSwitchFrames.clear();
+        for(unsigned i=0; i < mJoints.size(); ++i)
         {
-            ROS_INFO_STREAM(it->name << "[" << *res_it << "] START");
-            mMotor[*res_it]->switchController(it->type);
+            if(changed[mJoints[i]])
+            {
+                mSwitchFrames.push_back(mMotor[mJoints[i]]->stateFrame(STATE_CONTROL_DISABLE));
+                mMotor[mJoints[i]]->setState(STATE_CONTROL_DISABLE);
+            }
         }
+        mSerial->sendNow(mSwitchFrames.data(), mSwitchFrames.size(), mSwitchReplies);
+    }
+    // The next read is at full rate if a motor is driven
+    updateIdle();
+    // Latency of the switch
+    mSwitchLatencyMax = std::max(mSwitchLatencyMax, latency);
+    if(latency > mSwitchLatencyLimit)
+    {
+        ROS_WARN_STREAM("Switch of " << mSwitchFrames.size() << " motors in " << latency * 1000.0 << "ms, over " << mSwitchLatencyLimit * 1000.0 << "ms");
+    }
+    else
+    {
+        ROS_INFO_STREAM("Switch of " << mSwitchFrames.size() << " motors in " << latency * 1000.0 << "ms - max " << mSwitchLatencyMax * 1000.0 << "ms");
     }
 }
 
@@ -110,6 +584,16 @@ bool uNavInterface::updateDiagnostics()
     if(mSerial->getStatus() == orbus::SERIAL_OK)
     {
         ROS_DEBUG_STREAM("Update diagnostic");
+        // Plan again the link when the subscriptions change
+        size_t telemetry = 0;
+        for(unsigned i=0; i < mJoints.size(); ++i)
+        {
+            telemetry += mMotor[mJoints[i]]->telemetryFrames();
+        }
+        if(telemetry != mLinkTelemetry || information_frames.size() != mLinkGpio)
+        {
+            planLink();
+        }
         // Force update all diagnostic parts
         diagnostic_updater.force_update();
         return true;
@@ -133,46 +617,87 @@ void uNavInterface::initialize()
     // Launch super inizializer
     GenericInterface::initialize();
 
-    for( map<string, Motor*>::iterator ii=mMotor.begin(); ii!=mMotor.end(); ++ii)
+    // After a link loss the board can be restarted with the default configuration
+    if(mSynced && mCache != NULL)
+    {
+        ROS_INFO_STREAM("Link lost after the last configuration, the cache is not used");
+        mCache->clear();
+    }
+    // Read all parameters with one call, the snapshot is valid only for this configuration
+    mSnapshot->load();
+    // Collect the configuration of all motors
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        mMotor[mJoints[i]]->initializeMotor();
+        ROS_DEBUG_STREAM("Motor [" << mJoints[i] << "] Initialized");
+    }
+    // The parameters can change from dynamic reconfigure
+    mSnapshot->clear();
+    // Send all configurations in the minimum number of packets
+    std::vector<orbus::frame_result_t> results;
+    if(mSerial->sendList(results))
+    {
+        ROS_DEBUG_STREAM("Configuration uploaded");
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Unable to upload the configuration");
+    }
+    // Store in cache only the configuration acknowledged
+    unsigned int refused = 0;
+    for(unsigned i=0; i < results.size(); ++i)
+    {
+        if(results[i].type != HASHMAP_MOTOR || results[i].answer == orbus::FRAME_ACK)
+        {
+            continue;
+        }
+        motor_command_map_t motor;
+        motor.command_message = results[i].command;
+        ROS_WARN_STREAM("Motor [" << (int) motor.bitset.motor << "] configuration " << (int) motor.bitset.command
+                        << (results[i].answer == orbus::FRAME_NACK ? " refused from the board" : " not answered"));
+        refused++;
+        if(mCache != NULL)
+        {
+            mCache->invalidate(results[i].command);
+        }
+    }
+    if(mCache != NULL)
     {
-        (*ii).second->initializeMotor();
-        ROS_DEBUG_STREAM("Motor [" << (*ii).first << "] Initialized");
-        // Send list
-        mSerial->sendList();
+        mCache->commit();
     }
+    mSynced = true;
+    if(refused > 0)
+    {
+        ROS_WARN_STREAM("Configuration not applied in " << refused << " frames");
+    }
+    // The timeouts of the motors are known only now
+    limitRate();
 }
 
-void uNavInterface::initializeInterfaces()
+void uNavInterface::initializeInterfaces(const urdf::Model &model)
 {
     // Initialize the diagnostic from the primitive object
     initializeDiagnostic();
 
-    if (!model.initParam("/robot_description")){
-        ROS_ERROR("Failed to parse urdf file");
-    }
-    else
-    {
-        ROS_INFO_STREAM("/robot_description found! " << model.name_ << " parsed!");
-    }
-
-    for( map<string, Motor*>::iterator ii=mMotor.begin(); ii!=mMotor.end(); ++ii)
+    for(unsigned i=0; i < mJoints.size(); ++i)
     {
+        Motor *motor = mMotor[mJoints[i]];
         /// State interface
-        joint_state_interface.registerHandle(((*ii).second)->joint_state_handle);
+        joint_state_interface.registerHandle(motor->joint_state_handle);
         /// Velocity interface
-        velocity_joint_interface.registerHandle(((*ii).second)->joint_handle);
+        velocity_joint_interface.registerHandle(motor->joint_handle);
 
         // Setup limits
-        ((*ii).second)->setupLimits(model);
+        motor->setupLimits(model);
 
         // reset position joint
         double position = 0;
-        ROS_DEBUG_STREAM("Motor [" << (*ii).first << "] reset position to: " << position);
-        ((*ii).second)->resetPosition(position);
+        ROS_DEBUG_STREAM("Motor [" << mJoints[i] << "] reset position to: " << position);
+        motor->resetPosition(position);
 
         //Add motor in diagnostic updater
-        diagnostic_updater.add(*((*ii).second));
-        ROS_DEBUG_STREAM("Motor [" << (*ii).first << "] Registered");
+        diagnostic_updater.add(*motor);
+        ROS_DEBUG_STREAM("Motor [" << mJoints[i] << "] Registered");
     }
 
     ROS_DEBUG_STREAM("Send all Constraint configuration");
@@ -186,25 +711,87 @@ void uNavInterface::initializeInterfaces()
 
 void uNavInterface::read(const ros::Time& time, const ros::Duration& period) {
     //ROS_DEBUG_STREAM("Get measure from uNav");
-    for( map<string, Motor*>::iterator ii=mMotor.begin(); ii!=mMotor.end(); ++ii)
+    bool measure = mScheduler.due(STREAM_MEASURE);
+    // The board samples the measures in the middle of its turnaround
+    double turnaround = mSerial->getTurnaround();
+    ros::Time acquisition = ros::Time::now() + ros::Duration(turnaround / 2.0);
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        // The telemetry of each motor is on a different cycle
+        mMotor[mJoints[i]]->addRequestMeasure(measure, mScheduler.due(STREAM_TELEMETRY, i), acquisition);
+        ROS_DEBUG_STREAM("Motor [" << mJoints[i] << "] Request measures");
+    }
+    // All requests in one transaction
+    ros::WallTime start = ros::WallTime::now();
+    bool received = mSerial->sendList();
+    mCycleLatency = (ros::WallTime::now() - start).toSec();
+    // All measures of this cycle in one message
+    if(mAggregate && measure && received && gate_telemetry.due(pub_telemetry))
     {
-        (*ii).second->addRequestMeasure();
-        ROS_DEBUG_STREAM("Motor [" << (*ii).first << "] Request measures");
+        for(unsigned i=0; i < mJoints.size(); ++i)
+        {
+            const orbus_interface::ControlStatus &joint = mMotor[mJoints[i]]->measure();
+            msg_telemetry.pwm[i] = joint.pwm;
+            msg_telemetry.position[i] = joint.position;
+            msg_telemetry.velocity[i] = joint.velocity;
+            msg_telemetry.current[i] = joint.current;
+            msg_telemetry.effort[i] = joint.effort;
+        }
+        msg_telemetry.header.stamp = ros::Time::now();
+        // Only the serialization of the message allocates, it is not checked
+        orbus::allocation::pause unchecked;
+        pub_telemetry.publish(msg_telemetry);
+    }
+    // The command computed on this state is applied by the board after the update
+    // of the controller manager and the turnaround of the write transaction
+    mReadEnd = ros::WallTime::now();
+    ros::Time apply_time = ros::Time::now() + ros::Duration(mUpdateDelay + turnaround / 2.0);
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        mMotor[mJoints[i]]->updateEstimate(apply_time);
     }
 }
 
 void uNavInterface::write(const ros::Time& time, const ros::Duration& period) {
     //ROS_DEBUG_STREAM("Write command to uNav");
-    for( map<string, Motor*>::iterator ii=mMotor.begin(); ii!=mMotor.end(); ++ii)
+    // Host side safety, the stop is sent in the same cycle of the measure
+    for(unsigned i=0; i < mJoints.size() && !mEmergency; ++i)
     {
-        (*ii).second->writeCommandsToHardware(period);
-        ROS_DEBUG_STREAM("Motor [" << (*ii).first << "] Send commands");
+        if(mMotor[mJoints[i]]->emergencyRequired())
+        {
+            orbus::allocation::pause unchecked;
+            ROS_ERROR_STREAM("Motor [" << mJoints[i] << "] critical level, emergency stop");
+            emergencyStop();
+        }
+    }
+    bool commands = mScheduler.due(STREAM_COMMAND);
+    for(unsigned i=0; i < mJoints.size(); ++i)
+    {
+        if(mEmergency)
+        {
+            // The board is stopped, the motor is driven again only after a new switch
+            mMotor[mJoints[i]]->setState(STATE_CONTROL_DISABLE);
+        }
+        if(commands)
+        {
+            mMotor[mJoints[i]]->writeCommandsToHardware(period);
+            ROS_DEBUG_STREAM("Motor [" << mJoints[i] << "] Send commands");
+        }
     }
     //Send all messages
+    ros::WallTime start = ros::WallTime::now();
+    if(!mReadEnd.isZero())
+    {
+        mUpdateDelay = (start - mReadEnd).toSec();
+    }
     mSerial->sendList();
+    mCycleLatency += (ros::WallTime::now() - start).toSec();
+    mCycleLatencyMax = std::max(mCycleLatencyMax, mCycleLatency);
+    // End of the control cycle
+    mScheduler.tick();
 }
 
-void uNavInterface::allMotorsFrame(unsigned char option, unsigned char type, unsigned char command, message_abstract_u message)
+void uNavInterface::allMotorsFrame(unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message)
 {
 
     motor_command_map_t motor;
@@ -212,11 +799,9 @@ void uNavInterface::allMotorsFrame(unsigned char option, unsigned char type, uns
     int number_motor = (int) motor.bitset.motor;
     ROS_DEBUG_STREAM("Frame [Option: " << option << ", HashMap: " << type << ", Nmotor: " << number_motor << ", Command: " << (int) motor.bitset.command << "]");
 
-    if(mMotorName.find(number_motor) != mMotorName.end())
+    if(number_motor < MAX_MOTORS && mMotor[number_motor] != NULL)
     {
-        string name = mMotorName[number_motor];
-        // ROS_DEBUG_STREAM("Motor[" << number_motor << "] found! Name: " << name);
-        mMotor[name]->motorFrame(option, type, motor.bitset.command, message.motor);
+        mMotor[number_motor]->motorFrame(option, type, motor.bitset.command, message);
     }
     else
     {
@@ -22,11 +22,17 @@
 #include "hardware/serial_controller.h"
 
 #include "hardware/uNavInterface.h"
+#include "hardware/allocation_check.h"
 
 #include <boost/chrono.hpp>
 
+#include <future>
+
 typedef boost::chrono::steady_clock time_source;
 
+// Number of cycles before to check the allocations in the control loop
+#define ALLOCATION_WARMUP 100
+
 using namespace std;
 using namespace ORInterface;
 
@@ -48,10 +54,20 @@ void siginthandler(int param)
 }
 // <<<<< Ctrl+C handler
 
+/**
+* Log a step of the startup with the time from the start of the node
+*/
+void startupStep(const time_source::time_point &start_time, const string &step)
+{
+    boost::chrono::duration<double> elapsed = time_source::now() - start_time;
+    ROS_INFO_STREAM("STARTUP [" << elapsed.count() << "s] " << step);
+}
+
 /**
 * Control loop not realtime safe
 */
 void controlLoop(uNavInterface &orb,
+                 orbus::serial_controller &serial,
                  controller_manager::ControllerManager &cm,
                  time_source::time_point &last_time)
 {
@@ -61,21 +77,45 @@ void controlLoop(uNavInterface &orb,
     boost::chrono::duration<double> elapsed_duration = this_time - last_time;
     ros::Duration elapsed(elapsed_duration.count());
     last_time = this_time;
+    // Without the board the loop waits the diagnostic
+    if(orb.linkLost())
+    {
+        return;
+    }
 
     //ROS_INFO_STREAM("CONTROL - running");
+    // The frames received from the other threads do not change the joints during the cycle
+    std::lock_guard<std::recursive_mutex> lock(serial.dispatchMutex());
+    // After the warm up the control loop must not allocate memory
+    static unsigned long cycles = 0;
+    bool check = (++cycles > ALLOCATION_WARMUP);
+    if(check)
+    {
+        orbus::allocation::arm();
+    }
     // Internal data update
     orb.updateInterface();
     // Process control loop
     orb.read(ros::Time::now(), elapsed);
     cm.update(ros::Time::now(), elapsed);
     orb.write(ros::Time::now(), elapsed);
+    if(check)
+    {
+        unsigned long allocations = orbus::allocation::disarm();
+        if(allocations > 0)
+        {
+            ROS_ERROR_STREAM("CONTROL - " << allocations << " heap allocations in cycle " << cycles);
+        }
+    }
 }
 
 /**
 * Diagnostics loop for ORB boards, not realtime safe
 */
-void diagnosticLoop(uNavInterface &orb)
+void diagnosticLoop(uNavInterface &orb, orbus::serial_controller &serial)
 {
+    // The diagnostic reads the state updated from the callbacks
+    std::lock_guard<std::recursive_mutex> lock(serial.dispatchMutex());
     //ROS_INFO_STREAM("DIAGNOSTIC - running");
     bool diagnostic = orb.updateDiagnostics();
     // Set true if the diagnostic change with the before status
@@ -86,7 +126,14 @@ void diagnosticLoop(uNavInterface &orb)
         {
             ROS_INFO_STREAM("DIAGNOSTIC - Initialize again the unav and restart control loop");
             orb.initialize();
-            control_loop.start();
+            if(!orb.adaptiveRate())
+            {
+                control_loop.start();
+            }
+        }
+        else if(orb.adaptiveRate())
+        {
+            ROS_ERROR_STREAM("DIAGNOSTIC - Link lost, control loop at minimum rate");
         }
         else
         {
@@ -96,6 +143,11 @@ void diagnosticLoop(uNavInterface &orb)
         }
     }
     status = diagnostic;
+    // The control loop follows the status of the link, without stop
+    if(orb.adaptiveRate() && orb.updateRate(diagnostic))
+    {
+        control_loop.setPeriod(ros::Duration(1 / orb.controlFrequency()));
+    }
     //ROS_INFO_STREAM("New status:" << status);
 }
 
@@ -103,6 +155,7 @@ int main(int argc, char **argv) {
 
     ros::init(argc, argv, "unav_interface");
     ros::NodeHandle nh, private_nh("~");
+    time_source::time_point start_time = time_source::now();
 
     signal(SIGINT, siginthandler);
     ROS_INFO_STREAM("-------------------------------------");
@@ -120,38 +173,67 @@ int main(int argc, char **argv) {
     private_nh.param<int32_t>("serial_rate", baud_rate, 115200);
     ROS_INFO_STREAM("Open Serial " << serial_port_string << ":" << baud_rate);
 
+    // The URDF does not depend from the board, parse it while the board is configured
+    urdf::Model model;
+    std::future<bool> model_loaded = std::async(std::launch::async, [&model]() {
+        return model.initParam("/robot_description");
+    });
+
     orbus::serial_controller orbusSerial(serial_port_string, baud_rate);
     // Run the serial controller
     bool start = orbusSerial.start();
+    startupStep(start_time, "Serial probe");
     // If the conection start
     if(start)
     {
         uNavInterface interface(nh, private_nh, &orbusSerial);
+        startupStep(start_time, "Board identity and motors");
         // Initialize the motor parameters
         interface.initialize();
+        startupStep(start_time, "Configuration upload");
+        // Wait the URDF, if it is on the critical path the step is late
+        if (!model_loaded.get()){
+            ROS_ERROR("Failed to parse urdf file");
+        }
+        else
+        {
+            ROS_INFO_STREAM("/robot_description found! " << model.name_ << " parsed!");
+        }
+        startupStep(start_time, "URDF");
         //Initialize all interfaces and setup diagnostic messages
-        interface.initializeInterfaces();
+        interface.initializeInterfaces(model);
+        startupStep(start_time, "Limits and interfaces");
+        // The streams must fit in the serial link
+        if(!interface.planLink())
+        {
+            ROS_ERROR_STREAM("Serial link overloaded, shutting down");
+            return 1;
+        }
+
+        boost::chrono::duration<double> startup = time_source::now() - start_time;
+        ROS_INFO_STREAM("Startup in " << startup.count() << "s");
 
         controller_manager::ControllerManager cm(&interface, nh);
 
         // Setup separate queue and single-threaded spinner to process timer callbacks
         // that interface with uNav hardware.
         // This avoids having to lock around hardware access, but precludes realtime safety
-        // in the control loop.
+        // in the control loop. The frames sent from services and subscribers are
+        // dispatched under the lock of the serial controller held from both loops.
         ros::CallbackQueue unav_queue;
         ros::AsyncSpinner unav_spinner(1, &unav_queue);
 
         time_source::time_point last_time = time_source::now();
         ros::TimerOptions control_timer(
                     ros::Duration(1 / control_frequency),
-                    boost::bind(controlLoop, boost::ref(interface), boost::ref(cm), boost::ref(last_time)),
+                    boost::bind(controlLoop, boost::ref(interface), boost::ref(orbusSerial), boost::ref(cm), boost::ref(last_time)),
                     &unav_queue);
         // Global variable
         control_loop = nh.createTimer(control_timer);
 
         ros::TimerOptions diagnostic_timer(
                     ros::Duration(1 / diagnostic_frequency),
-                    boost::bind(diagnosticLoop, boost::ref(interface)),
+                    boost::bind(diagnosticLoop, boost::ref(interface), boost::ref(orbusSerial)),
                     &unav_queue);
         diagnostic_loop = nh.createTimer(diagnostic_timer);
 
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include "hardware/allocation_check.h"
+
+#include <stdlib.h>
+
+#include <string>
+
+/**
+ * The test is built with ALLOCATION_CHECK_ABORT, each allocation
+ * in the armed window stops the process
+ */
+
+// The result is used, the allocation is not removed from the compiler
+static void * volatile sink;
+
+TEST(AllocationCheck, mallocAborts)
+{
+    EXPECT_DEATH({ orbus::allocation::arm(); sink = malloc(16); }, "Heap allocation");
+}
+
+TEST(AllocationCheck, newArrayAborts)
+{
+    EXPECT_DEATH({ orbus::allocation::arm(); sink = new int[4]; }, "Heap allocation");
+}
+
+TEST(AllocationCheck, alignedAborts)
+{
+    EXPECT_DEATH({ orbus::allocation::arm(); void *ptr = NULL; if(posix_memalign(&ptr, 64, 64) == 0) { sink = ptr; } }, "Heap allocation");
+    EXPECT_DEATH({ orbus::allocation::arm(); sink = aligned_alloc(64, 64); }, "Heap allocation");
+}
+
+TEST(AllocationCheck, pauseExcludes)
+{
+    orbus::allocation::arm();
+    {
+        orbus::allocation::pause unchecked;
+        std::string text(256, 'x');
+        sink = &text[0];
+    }
+    EXPECT_EQ(0u, orbus::allocation::disarm());
+}
+
+TEST(AllocationCheck, disarmedAllocates)
+{
+    orbus::allocation::arm();
+    orbus::allocation::disarm();
+    int *values = new int[4];
+    sink = values;
+    delete[] values;
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    testing::FLAGS_gtest_death_test_style = "threadsafe";
+    return RUN_ALL_TESTS();
+}
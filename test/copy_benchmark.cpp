@@ -0,0 +1,79 @@
+/**
+ * Bytes copied by the transport for each transaction of the control loop.
+ * A fake board answers each packet with the measures of all motors, the
+ * control loop sends the references and the measure requests of all motors.
+ * The bytes copied are compared with the bytes of the frames on the wire.
+ *
+ * Usage: copy_benchmark [motors] [cycles]
+ */
+#include <ros/ros.h>
+
+#include "hardware/serial_controller.h"
+#include "fake_board.h"
+
+#include <cstdio>
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    ros::Time::init();
+    unsigned int motors = (argc > 1 ? atoi(argv[1]) : 4);
+    unsigned int cycles = (argc > 2 ? atoi(argv[2]) : 1000);
+
+    FakeBoard board;
+    if(!board.open())
+    {
+        fprintf(stderr, "Unable to open the pseudo terminal\n");
+        return 1;
+    }
+    message_abstract_u message;
+    memset(&message, 0, sizeof(message));
+    vector<packet_information_t> reply, cycle;
+    for(unsigned int i = 0; i < motors; ++i)
+    {
+        motor_command_map_t motor;
+        motor.bitset.motor = i;
+        motor.bitset.command = MOTOR_MEASURE;
+        reply.push_back(CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message));
+        cycle.push_back(CREATE_PACKET_RESPONSE(motor.command_message, HASHMAP_MOTOR, PACKET_REQUEST));
+        motor.bitset.command = MOTOR_VEL_REF;
+        message.motor.reference = 1000;
+        cycle.push_back(CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message));
+    }
+    board.setReply(reply);
+
+    orbus::serial_controller serial(board.port(), 115200);
+    if(!serial.start())
+    {
+        fprintf(stderr, "Unable to start the serial controller\n");
+        return 1;
+    }
+    // Frames of a cycle on the wire, a large cycle is split in more packets
+    double tx = 0;
+    for(size_t i = 0; i < cycle.size(); ++i)
+    {
+        tx += cycle[i].length;
+    }
+    // Each packet is answered with the same reply, all frames have the same length
+    unsigned long calls = 0;
+    serial.addCallback([&](unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
+        calls++;
+    }, HASHMAP_MOTOR);
+
+    unsigned long start = serial.getCopied();
+    unsigned int answered = 0;
+    for(unsigned int i = 0; i < cycles; ++i)
+    {
+        answered += serial.addFrame(cycle)->sendList();
+    }
+    double copied = (double) (serial.getCopied() - start) / cycles;
+    double rx = (double) calls * reply[0].length / cycles;
+
+    printf("Copies of the transport - %u motors - %u cycles - %u answered - %lu callbacks\n", motors, cycles, answered, calls);
+    printf("%-24s %8.1f bytes\n", "Frames sent", tx);
+    printf("%-24s %8.1f bytes\n", "Frames received", rx);
+    printf("%-24s %8.1f bytes\n", "Copied per transaction", copied);
+    printf("%-24s %8.2f\n", "Copied / on the wire", copied / (tx + rx));
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+ * Worst case latency of the emergency stop under full control load.
+ * A control thread sends the references and the measure requests of all
+ * motors back to back on a fake board, another thread writes the emergency
+ * stop at random times. For each stop are measured the time to write the
+ * emergency packet and the time to wake the control thread blocked on the reply.
+ *
+ * Usage: emergency_benchmark [turnaround us] [motors] [stops]
+ */
+#include <ros/ros.h>
+
+#include "hardware/serial_controller.h"
+#include "fake_board.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <random>
+
+using namespace std;
+
+/**
+ * Print min, average, 99 percentile and max of a list of latencies
+ */
+static void report(const char *name, vector<double> &latency)
+{
+    if(latency.empty())
+    {
+        printf("%-24s no samples\n", name);
+        return;
+    }
+    sort(latency.begin(), latency.end());
+    double sum = 0;
+    for(size_t i = 0; i < latency.size(); ++i)
+    {
+        sum += latency[i];
+    }
+    printf("%-24s min %8.1fus - avg %8.1fus - p99 %8.1fus - max %8.1fus\n", name,
+           latency.front() * 1e6, sum / latency.size() * 1e6,
+           latency[(latency.size() * 99) / 100] * 1e6, latency.back() * 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    ros::Time::init();
+    unsigned int turnaround = (argc > 1 ? atoi(argv[1]) : 2000);
+    unsigned int motors = (argc > 2 ? atoi(argv[2]) : 4);
+    unsigned int stops = (argc > 3 ? atoi(argv[3]) : 200);
+
+    FakeBoard board;
+    if(!board.open())
+    {
+        fprintf(stderr, "Unable to open the pseudo terminal\n");
+        return 1;
+    }
+    message_abstract_u message;
+    memset(&message, 0, sizeof(message));
+    board.setReply(vector<packet_information_t>(motors, CREATE_PACKET_DATA(MOTOR_MEASURE, HASHMAP_MOTOR, message)));
+    board.setTurnaround(turnaround);
+
+    orbus::serial_controller serial(board.port(), 115200);
+    if(!serial.start())
+    {
+        fprintf(stderr, "Unable to start the serial controller\n");
+        return 1;
+    }
+    // Emergency of all motors and one cycle of the control loop
+    vector<packet_information_t> emergency, cycle;
+    for(unsigned int i = 0; i < motors; ++i)
+    {
+        motor_command_map_t motor;
+        motor.bitset.motor = i;
+        motor.bitset.command = MOTOR_STATE;
+        message.motor.state = STATE_CONTROL_DISABLE;
+        emergency.push_back(CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message));
+        motor.bitset.command = MOTOR_VEL_REF;
+        message.motor.reference = 1000;
+        cycle.push_back(CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message));
+        motor.bitset.command = MOTOR_MEASURE;
+        cycle.push_back(CREATE_PACKET_RESPONSE(motor.command_message, HASHMAP_MOTOR, PACKET_REQUEST));
+    }
+    serial.setEmergency(emergency);
+
+    // Control loop at full load, the end of each transaction is stored
+    atomic<bool> running(true);
+    atomic<double> last_end(0);
+    thread control([&]() {
+        while(running)
+        {
+            serial.resetList();
+            serial.addFrame(cycle)->sendList();
+            last_end = ros::WallTime::now().toSec();
+        }
+    });
+
+    vector<double> write_latency, wake_latency;
+    mt19937 generator(0);
+    uniform_int_distribution<int> wait(1000, 3 * turnaround + 1000);
+    for(unsigned int i = 0; i < stops; ++i)
+    {
+        this_thread::sleep_for(chrono::microseconds(wait(generator)));
+        double start = ros::WallTime::now().toSec();
+        serial.emergency();
+        write_latency.push_back(ros::WallTime::now().toSec() - start);
+        // The control thread returns from the transaction in progress
+        double deadline = start + 1.0;
+        while(last_end < start && ros::WallTime::now().toSec() < deadline)
+        {
+            this_thread::yield();
+        }
+        wake_latency.push_back(last_end - start);
+        serial.releaseEmergency();
+    }
+    running = false;
+    control.join();
+
+    printf("Emergency stop - %u motors - board turnaround %uus - %u stops\n", motors, turnaround, stops);
+    report("Write emergency", write_latency);
+    report("Wake control thread", wake_latency);
+    return 0;
+}
@@ -0,0 +1,158 @@
+#ifndef FAKE_BOARD_H
+#define FAKE_BOARD_H
+
+#include <or_bus/or_message.h>
+#include <or_bus/or_frame.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The FakeBoard class Board on a pseudo terminal, the serial controller
+ * opens the slave side. Each packet received is answered with the same reply,
+ * after the configured turnaround. All packets received are stored.
+ * A packet on the wire is [sync][length][frames ...][checksum].
+ */
+class FakeBoard
+{
+public:
+    FakeBoard()
+        : mMaster(-1)
+        , mRunning(false)
+        , mTurnaround(0)
+        , mReplySize(0)
+    {
+    }
+
+    ~FakeBoard()
+    {
+        close();
+    }
+    /**
+     * @brief open Create the pseudo terminal and start the board
+     * @return true if the slave side is available
+     */
+    bool open()
+    {
+        mMaster = posix_openpt(O_RDWR | O_NOCTTY);
+        if(mMaster < 0 || grantpt(mMaster) != 0 || unlockpt(mMaster) != 0)
+        {
+            return false;
+        }
+        char name[128];
+        if(ptsname_r(mMaster, name, sizeof(name)) != 0)
+        {
+            return false;
+        }
+        mPort = name;
+        mRunning = true;
+        mThread = std::thread(&FakeBoard::worker, this);
+        return true;
+    }
+
+    void close()
+    {
+        mRunning = false;
+        if(mThread.joinable())
+        {
+            mThread.join();
+        }
+        if(mMaster >= 0)
+        {
+            ::close(mMaster);
+            mMaster = -1;
+        }
+    }
+    /// Name of the port for the serial controller
+    const std::string &port() const { return mPort; }
+    /**
+     * @brief setReply Frames sent back for each packet
+     * @param frames all frames of the reply, in one packet
+     */
+    void setReply(const std::vector<packet_information_t> &frames)
+    {
+        packet_t packet;
+        encoder(&packet, const_cast<packet_information_t*>(frames.data()), frames.size());
+        std::lock_guard<std::mutex> lock(mMutex);
+        build_pkg(mReply, packet);
+        mReplySize = LNG_PACKET_HEADER + packet.length + 1;
+    }
+    /**
+     * @brief setTurnaround Time of the board to answer a packet
+     * @param turnaround the time in microseconds
+     */
+    void setTurnaround(unsigned int turnaround) { mTurnaround = turnaround; }
+    /**
+     * @brief packets All packets received, without sync and checksum
+     * @return the frames of each packet
+     */
+    std::vector<std::vector<unsigned char> > packets()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPackets;
+    }
+
+private:
+    void worker()
+    {
+        std::vector<unsigned char> buffer;
+        unsigned char data[MAX_BUFF_TX];
+        while(mRunning)
+        {
+            struct pollfd fd = { mMaster, POLLIN, 0 };
+            if(poll(&fd, 1, 10) <= 0 || !(fd.revents & POLLIN))
+            {
+                continue;
+            }
+            ssize_t size = read(mMaster, data, sizeof(data));
+            if(size <= 0)
+            {
+                continue;
+            }
+            buffer.insert(buffer.end(), data, data + size);
+            // Answer each complete packet
+            while(buffer.size() >= LNG_PACKET_HEADER)
+            {
+                size_t length = buffer[LNG_PACKET_HEADER - 1];
+                size_t total = LNG_PACKET_HEADER + length + 1;
+                if(buffer.size() < total)
+                {
+                    break;
+                }
+                std::vector<unsigned char> frames(buffer.begin() + LNG_PACKET_HEADER, buffer.begin() + LNG_PACKET_HEADER + length);
+                buffer.erase(buffer.begin(), buffer.begin() + total);
+                std::this_thread::sleep_for(std::chrono::microseconds(mTurnaround));
+                std::lock_guard<std::mutex> lock(mMutex);
+                mPackets.push_back(frames);
+                if(mReplySize > 0 && write(mMaster, mReply, mReplySize) != (ssize_t) mReplySize)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Master side of the pseudo terminal
+    int mMaster;
+    std::string mPort;
+    std::atomic<bool> mRunning;
+    std::thread mThread;
+    // Turnaround of the board in microseconds
+    std::atomic<unsigned int> mTurnaround;
+    // Reply to each packet and packets received
+    std::mutex mMutex;
+    unsigned char mReply[MAX_BUFF_TX];
+    size_t mReplySize;
+    std::vector<std::vector<unsigned char> > mPackets;
+};
+
+#endif // FAKE_BOARD_H
@@ -0,0 +1,316 @@
+#include <gtest/gtest.h>
+
+#include <ros/ros.h>
+
+#include "hardware/serial_controller.h"
+#include "fake_board.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+
+using namespace std;
+
+/**
+ * Serial controller connected to a fake board, each packet is answered
+ * with one SYSTEM_TIME frame
+ */
+class SerialControllerTest : public ::testing::Test
+{
+protected:
+    SerialControllerTest()
+        : serial(NULL)
+        , blocked(false)
+    {
+    }
+
+    void SetUp()
+    {
+        ASSERT_TRUE(board.open());
+        message_abstract_u message;
+        memset(&message, 0, sizeof(message));
+        board.setReply(vector<packet_information_t>(1, CREATE_PACKET_DATA(SYSTEM_TIME, HASHMAP_SYSTEM, message)));
+        serial = new orbus::serial_controller(board.port(), 115200);
+        ASSERT_TRUE(serial->start());
+        request = CREATE_PACKET_RESPONSE(SYSTEM_TIME, HASHMAP_SYSTEM, PACKET_REQUEST);
+    }
+
+    void TearDown()
+    {
+        // A thread still blocked uses the controller, it is left to the end of the process
+        if(!blocked)
+        {
+            delete serial;
+            board.close();
+        }
+    }
+    /**
+     * @brief run Run a function on a new thread
+     * @param task the function
+     * @param timeout maximum time to wait the end
+     * @return true if the function is ended in time
+     */
+    bool run(const function<void()> &task, chrono::milliseconds timeout)
+    {
+        shared_ptr<promise<void> > done = make_shared<promise<void> >();
+        future<void> ended = done->get_future();
+        thread([task, done]() {
+            task();
+            done->set_value();
+        }).detach();
+        if(ended.wait_for(timeout) != future_status::ready)
+        {
+            blocked = true;
+            return false;
+        }
+        return true;
+    }
+
+    FakeBoard board;
+    orbus::serial_controller *serial;
+    packet_information_t request;
+    bool blocked;
+};
+
+TEST_F(SerialControllerTest, callbackSendsFrames)
+{
+    int calls = 0;
+    bool nested = false;
+    serial->addCallback([&](unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
+        // The first reply sends a new request from the callback
+        if(calls++ == 0)
+        {
+            nested = serial->addFrame(request)->sendList();
+        }
+    }, HASHMAP_SYSTEM);
+
+    bool sent = false;
+    ASSERT_TRUE(run([&]() { sent = serial->addFrame(request)->sendList(); }, chrono::milliseconds(5000))) << "sendList deadlocked from a callback";
+    EXPECT_TRUE(sent);
+    EXPECT_TRUE(nested);
+    EXPECT_EQ(2, calls);
+}
+
+TEST_F(SerialControllerTest, callbackSendsNow)
+{
+    message_abstract_u message;
+    memset(&message, 0, sizeof(message));
+    packet_information_t reply = CREATE_PACKET_DATA(SYSTEM_TIME, HASHMAP_SYSTEM, message);
+    board.setReply(vector<packet_information_t>(2, reply));
+    int calls = 0;
+    bool nested = false;
+    vector<packet_information_t> inner;
+    serial->addCallback([&](unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
+        // The first reply sends a new batch from the callback, with a different answer
+        if(calls++ == 0)
+        {
+            board.setReply(vector<packet_information_t>(3, reply));
+            nested = serial->sendNow(&request, 1, inner);
+        }
+    }, HASHMAP_SYSTEM);
+
+    bool sent = false;
+    vector<packet_information_t> replies;
+    ASSERT_TRUE(run([&]() { sent = serial->sendNow(&request, 1, replies); }, chrono::milliseconds(5000))) << "sendNow deadlocked from a callback";
+    EXPECT_TRUE(sent);
+    EXPECT_TRUE(nested);
+    EXPECT_EQ(2u, replies.size());
+    EXPECT_EQ(3u, inner.size());
+    // The outer replies are not overwritten from the nested batch
+    EXPECT_EQ(5, calls);
+}
+
+TEST_F(SerialControllerTest, callbacksAreSerialized)
+{
+    atomic<int> inside(0), maximum(0), calls(0);
+    serial->addCallback([&](unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
+        int now = ++inside;
+        int last = maximum;
+        while(now > last && !maximum.compare_exchange_weak(last, now)) { }
+        // Large window for a second callback
+        this_thread::sleep_for(chrono::milliseconds(2));
+        calls++;
+        inside--;
+    }, HASHMAP_SYSTEM);
+
+    ASSERT_TRUE(run([&]() {
+        // Two producers, as the control loop and a service
+        thread producer([&]() {
+            for(int i = 0; i < 20; ++i)
+            {
+                serial->addFrame(request)->sendList();
+            }
+        });
+        for(int i = 0; i < 20; ++i)
+        {
+            serial->addFrame(request)->sendList();
+        }
+        producer.join();
+    }, chrono::milliseconds(10000))) << "sendList deadlocked";
+    EXPECT_EQ(1, maximum);
+    EXPECT_GE(calls, 40);
+}
+
+TEST_F(SerialControllerTest, dispatchWaitsTheLock)
+{
+    atomic<int> calls(0);
+    serial->addCallback([&](unsigned char option, unsigned char type, unsigned char command, const message_abstract_u &message) {
+        calls++;
+    }, HASHMAP_SYSTEM);
+
+    future<bool> sent;
+    {
+        // As the control loop, the frames of the other threads wait the end of the cycle
+        lock_guard<recursive_mutex> lock(serial->dispatchMutex());
+        sent = async(launch::async, [this]() { return serial->addFrame(request)->sendList(); });
+        this_thread::sleep_for(chrono::milliseconds(200));
+        EXPECT_EQ(0, calls);
+        // The transport is not locked from the callbacks
+        EXPECT_TRUE(serial->addFrame(request)->sendList());
+        EXPECT_EQ(1, calls);
+    }
+    ASSERT_EQ(future_status::ready, sent.wait_for(chrono::milliseconds(5000)));
+    EXPECT_TRUE(sent.get());
+    EXPECT_EQ(2, calls);
+}
+
+TEST_F(SerialControllerTest, resultOfEachFrame)
+{
+    motor_command_map_t motor;
+    motor.bitset.motor = 1;
+    motor.bitset.command = MOTOR_VEL_REF;
+    message_abstract_u message;
+    memset(&message, 0, sizeof(message));
+    packet_information_t reference = CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message);
+
+    vector<orbus::frame_result_t> results;
+    EXPECT_TRUE(serial->addFrame(reference)->addFrame(request)->sendList(results));
+    ASSERT_EQ(2u, results.size());
+    // The board answers only the request
+    EXPECT_EQ(HASHMAP_MOTOR, results[0].type);
+    EXPECT_EQ(motor.command_message, results[0].command);
+    EXPECT_EQ(orbus::FRAME_MISSING, results[0].answer);
+    EXPECT_EQ(orbus::FRAME_DATA, results[1].answer);
+}
+
+TEST_F(SerialControllerTest, failureDropsWrittenFrames)
+{
+    // A board that answers with an empty packet
+    board.setReply(vector<packet_information_t>());
+    EXPECT_FALSE(serial->addFrame(request)->sendList());
+    // Only the new frame is sent
+    message_abstract_u message;
+    memset(&message, 0, sizeof(message));
+    board.setReply(vector<packet_information_t>(1, CREATE_PACKET_DATA(SYSTEM_TIME, HASHMAP_SYSTEM, message)));
+    vector<orbus::frame_result_t> results;
+    EXPECT_TRUE(serial->addFrame(request)->sendList(results));
+    EXPECT_EQ(1u, results.size());
+}
+
+TEST_F(SerialControllerTest, addFrameDoesNotWait)
+{
+    // The transaction in progress holds the transport for the slow board
+    board.setTurnaround(300000);
+    future<bool> sent = async(launch::async, [this]() { return serial->addFrame(request)->sendList(); });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    serial->addFrame(request);
+    EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(100));
+    ASSERT_EQ(future_status::ready, sent.wait_for(chrono::milliseconds(2000)));
+    EXPECT_TRUE(sent.get());
+    // The frame queued goes with the next transaction
+    board.setTurnaround(0);
+    vector<orbus::frame_result_t> results;
+    EXPECT_TRUE(serial->sendList(results));
+    EXPECT_EQ(1u, results.size());
+}
+
+TEST_F(SerialControllerTest, sendNowInOnePacket)
+{
+    vector<packet_information_t> replies;
+    EXPECT_TRUE(serial->sendNow(&request, 1, replies));
+    EXPECT_EQ(1u, replies.size());
+    size_t packets = board.packets().size();
+    // A batch larger than one packet is not sent at all
+    vector<packet_information_t> batch(MAX_BUFF_TX, request);
+    EXPECT_FALSE(serial->sendNow(batch.data(), batch.size(), replies));
+    EXPECT_TRUE(replies.empty());
+    EXPECT_EQ(packets, board.packets().size());
+}
+
+/**
+ * Check if a packet received from the board has a motor frame
+ */
+static bool hasMotorCommand(const vector<unsigned char> &packet, unsigned char command)
+{
+    for(size_t i = 0; i < packet.size() && packet[i] > 0; i += packet[i])
+    {
+        const packet_information_t *frame = (const packet_information_t*) &packet[i];
+        motor_command_map_t motor;
+        motor.command_message = frame->command;
+        if(frame->type == HASHMAP_MOTOR && motor.bitset.command == command)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST_F(SerialControllerTest, emergencyLatchesReferences)
+{
+    motor_command_map_t motor;
+    motor.bitset.motor = 0;
+    motor.bitset.command = MOTOR_STATE;
+    message_abstract_u message;
+    memset(&message, 0, sizeof(message));
+    message.motor.state = STATE_CONTROL_DISABLE;
+    ASSERT_TRUE(serial->setEmergency(vector<packet_information_t>(1, CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message))));
+    motor.bitset.command = MOTOR_VEL_REF;
+    message.motor.reference = 1000;
+    packet_information_t reference = CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message);
+
+    // The reader waits the reply of a slow board
+    board.setTurnaround(300000);
+    future<bool> sent = async(launch::async, [&]() { return serial->addFrame(reference)->sendList(); });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    ASSERT_TRUE(serial->emergency());
+    ASSERT_EQ(future_status::ready, sent.wait_for(chrono::milliseconds(100))) << "Reader not woken from the emergency";
+    EXPECT_FALSE(sent.get());
+    EXPECT_TRUE(serial->isLatched());
+    EXPECT_EQ(orbus::SERIAL_OK, serial->getStatus());
+
+    // The reference of the next cycle is dropped
+    serial->resetList();
+    EXPECT_TRUE(serial->addFrame(reference)->sendList());
+    vector<vector<unsigned char> > packets = board.packets();
+    ASSERT_FALSE(packets.empty());
+    EXPECT_TRUE(hasMotorCommand(packets.back(), MOTOR_STATE));
+    EXPECT_FALSE(hasMotorCommand(packets.back(), MOTOR_VEL_REF));
+
+    // Also the other motor writes are dropped, the requests are sent
+    motor.bitset.command = MOTOR_POS_RESET;
+    serial->addFrame(CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message));
+    motor.bitset.command = MOTOR_VEL_PID;
+    serial->addFrame(CREATE_PACKET_DATA(motor.command_message, HASHMAP_MOTOR, message));
+    motor.bitset.command = MOTOR_MEASURE;
+    EXPECT_TRUE(serial->addFrame(CREATE_PACKET_RESPONSE(motor.command_message, HASHMAP_MOTOR, PACKET_REQUEST))->sendList());
+    packets = board.packets();
+    EXPECT_TRUE(hasMotorCommand(packets.back(), MOTOR_MEASURE));
+    EXPECT_FALSE(hasMotorCommand(packets.back(), MOTOR_POS_RESET));
+    EXPECT_FALSE(hasMotorCommand(packets.back(), MOTOR_VEL_PID));
+
+    // After the release the references are sent again
+    board.setTurnaround(0);
+    serial->releaseEmergency();
+    EXPECT_TRUE(serial->addFrame(reference)->sendList());
+    packets = board.packets();
+    EXPECT_TRUE(hasMotorCommand(packets.back(), MOTOR_VEL_REF));
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::Time::init();
+    return RUN_ALL_TESTS();
+}